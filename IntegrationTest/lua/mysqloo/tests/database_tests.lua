@@ -118,6 +118,20 @@ TestFramework:RegisterTest("[Database] wait for queries when disconnecting", fun
 	test:Complete()
 end)
 
+TestFramework:RegisterTest("[Database] fail queries started after disconnecting", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	db:disconnect()
+	local qu = db:query("SELECT 1")
+	function qu:onSuccess()
+		test:Fail("Query should not have been run")
+	end
+	function qu:onError(err)
+		test:shouldBeEqual(err:find("disconnecting") != nil, true)
+		test:Complete()
+	end
+	qu:start()
+end)
+
 TestFramework:RegisterTest("[Database] setting SSLMode to SSL_MODE_VERIFY_IDENTITY should fail the connection", function(test)
 	local db = mysqloo.connect(DatabaseSettings.Host, DatabaseSettings.Username, DatabaseSettings.Password, DatabaseSettings.Database, DatabaseSettings.Port)
 	db:setSSLMode(mysqloo.SSL_MODE_VERIFY_IDENTITY)
@@ -129,4 +143,103 @@ TestFramework:RegisterTest("[Database] setting SSLMode to SSL_MODE_VERIFY_IDENTI
 	    test:shouldBeEqual(err:find("SSL connection error") != nil, true)
         test:Complete()
 	end
-end)
\ No newline at end of file
+end)
+TestFramework:RegisterTest("[Database] should not block queries behind a slow query with multiple connections", function(test)
+	local db = mysqloo.connect(DatabaseSettings.Host, DatabaseSettings.Username, DatabaseSettings.Password, DatabaseSettings.Database, DatabaseSettings.Port)
+	db:setConnectionCount(2)
+	db:connect()
+	db:wait()
+	local slowFinished = false
+	local slowQuery = db:query("SELECT SLEEP(1)")
+	function slowQuery:onSuccess()
+		slowFinished = true
+		test:Complete()
+	end
+	local fastQuery = db:query("SELECT 1 as a")
+	function fastQuery:onSuccess(data)
+		test:shouldBeEqual(slowFinished, false)
+		test:shouldBeEqual(data[1].a, 1)
+	end
+	slowQuery:start()
+	fastQuery:start()
+end)
+
+TestFramework:RegisterTest("[Database] should not block other databases behind slow prepared queries", function(test)
+	local slowDb = mysqloo.connect(DatabaseSettings.Host, DatabaseSettings.Username, DatabaseSettings.Password, DatabaseSettings.Database, DatabaseSettings.Port)
+	slowDb:setConnectionCount(4)
+	slowDb:connect()
+	slowDb:wait()
+	local db = TestFramework:ConnectToDatabase()
+	//Prepared queries keep their thread busy until the server responds, the pool for them has at least 4 threads
+	//On linux the fast query doesn't need one of these, since it never waits for the server
+	local slowFinished = 0
+	for i = 1, 4 do
+		local slowQuery = slowDb:prepare("SELECT SLEEP(1)")
+		function slowQuery:onSuccess()
+			slowFinished = slowFinished + 1
+			if (slowFinished == 4) then
+				test:Complete()
+			end
+		end
+		slowQuery:start()
+	end
+	local fastQuery = db:query("SELECT 1 as a")
+	function fastQuery:onSuccess(data)
+		test:shouldBeEqual(slowFinished, 0)
+		test:shouldBeEqual(data[1].a, 1)
+	end
+	fastQuery:start()
+end)
+
+TestFramework:RegisterTest("[Database] should not occupy a thread while waiting for slow queries", function(test)
+	if (!system.IsLinux()) then
+		test:Complete() //Queries always wait for the server with a blocked thread on other platforms
+		return
+	end
+	local db = mysqloo.connect(DatabaseSettings.Host, DatabaseSettings.Username, DatabaseSettings.Password, DatabaseSettings.Database, DatabaseSettings.Port)
+	db:setConnectionCount(32)
+	db:connect()
+	db:wait()
+	local startTime = SysTime()
+	local finished = 0
+	for i = 1, 32 do
+		local qu = db:query("SELECT SLEEP(1)")
+		function qu:onSuccess()
+			finished = finished + 1
+			if (finished == 32) then
+				test:shouldBeEqual(db:parkedQueryCount() >= 32, true)
+				test:shouldBeEqual(SysTime() - startTime < 3, true)
+				test:Complete()
+			end
+		end
+		qu:start()
+	end
+end)
+
+TestFramework:RegisterTest("[Database] should not allow setting the connection count after connecting", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	local success = pcall(function() db:setConnectionCount(2) end)
+	test:shouldBeEqual(success, false)
+	test:Complete()
+end)
+
+TestFramework:RegisterTest("[Database] should run all callbacks with a think budget", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	test:shouldBeEqual(pcall(function() mysqloo.setThinkBudget(-1) end), false)
+	mysqloo.setThinkBudget(0.001)
+	local finishedCount = 0
+	for i = 1, 5 do
+		local qu = db:query("SELECT " .. i .. " as a")
+		function qu:onSuccess(data)
+			finishedCount = finishedCount + 1
+			test:shouldBeEqual(data[1].a, finishedCount)
+			test:shouldBeEqual(type(db:callbackBacklog()), "number")
+			if finishedCount == 5 then
+				mysqloo.setThinkBudget(0)
+				test:shouldBeEqual(db:callbackBacklog(), 0)
+				test:Complete()
+			end
+		end
+		qu:start()
+	end
+end)
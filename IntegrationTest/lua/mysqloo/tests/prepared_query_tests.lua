@@ -298,4 +298,271 @@ TestFramework:RegisterTest("[Prepared Query] Work with stored procedure correctl
 	qu:getNextResults()
 	test:shouldBeEqual(qu:hasMoreResults(), false)
 	test:Complete()
-end)
\ No newline at end of file
+end)
+TestFramework:RegisterTest("[Prepared Query] return native column types correctly", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	TestFramework:RunQuery(db, [[DROP TABLE IF EXISTS native_types_test]])
+	TestFramework:RunQuery(db, [[CREATE TABLE native_types_test(a INT, b BIGINT UNSIGNED, c DOUBLE, d DATETIME, e DATE, f TIME, g DATETIME(3), h VARCHAR(10))]])
+	TestFramework:RunQuery(db, [[INSERT INTO native_types_test VALUES(-5, 4294967296, 1.25, '2020-01-02 03:04:05', '2020-01-02', '-27:04:05', '2020-01-02 03:04:05.678', 'test')]])
+	TestFramework:RunQuery(db, [[INSERT INTO native_types_test VALUES(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL)]])
+	local qu = db:prepare("SELECT * FROM native_types_test")
+	qu:start()
+	qu:wait()
+	local data = qu:getData()
+	test:shouldHaveLength(data, 2)
+	test:shouldBeEqual(data[1].a, -5)
+	test:shouldBeEqual(data[1].b, 4294967296)
+	test:shouldBeEqual(data[1].c, 1.25)
+	test:shouldBeEqual(data[1].d, "2020-01-02 03:04:05")
+	test:shouldBeEqual(data[1].e, "2020-01-02")
+	test:shouldBeEqual(data[1].f, "-27:04:05")
+	test:shouldBeEqual(data[1].g, "2020-01-02 03:04:05.678")
+	test:shouldBeEqual(data[1].h, "test")
+	for _, column in ipairs({"a", "b", "c", "d", "e", "f", "g", "h"}) do
+		test:shouldBeNil(data[2][column])
+	end
+	test:Complete()
+end)
+
+TestFramework:RegisterTest("[Prepared Query] merge queued inserts if enabled", function(test)
+	local db = mysqloo.connect(DatabaseSettings.Host, DatabaseSettings.Username, DatabaseSettings.Password, DatabaseSettings.Database, DatabaseSettings.Port)
+	db:setCoalesceInserts(true)
+	db:connect()
+	db:wait()
+	TestFramework:RunQuery(db, [[DROP TABLE IF EXISTS coalesce_test]])
+	TestFramework:RunQuery(db, [[CREATE TABLE coalesce_test(id INT AUTO_INCREMENT PRIMARY KEY, value INT NOT NULL)]])
+	local insertsBefore = tonumber(TestFramework:RunQuery(db, "SHOW SESSION STATUS LIKE 'Com_insert'")[1].Value)
+	local finished = 0
+	for i = 1, 50 do
+		local qu = db:prepare("INSERT INTO coalesce_test (value) VALUES (?)")
+		qu:setNumber(1, i)
+		function qu:onSuccess()
+			test:shouldBeEqual(qu:affectedRows(), 1)
+			test:shouldBeEqual(qu:lastInsert(), i)
+			finished = finished + 1
+			if (finished == 50) then
+				local data = TestFramework:RunQuery(db, "SELECT SUM(value) as total FROM coalesce_test WHERE id = value")
+				test:shouldBeEqual(data[1].total, 50 * 51 / 2)
+				// The queries are queued faster than the single connection runs them, so most of them are merged
+				local insertsAfter = tonumber(TestFramework:RunQuery(db, "SHOW SESSION STATUS LIKE 'Com_insert'")[1].Value)
+				test:shouldBeGreaterThan(50, insertsAfter - insertsBefore)
+				test:Complete()
+			end
+		end
+		qu:start()
+	end
+end)
+
+TestFramework:RegisterTest("[Prepared Query] run merged inserts one by one if a row is a duplicate", function(test)
+	local db = mysqloo.connect(DatabaseSettings.Host, DatabaseSettings.Username, DatabaseSettings.Password, DatabaseSettings.Database, DatabaseSettings.Port)
+	db:setCoalesceInserts(true)
+	db:connect()
+	db:wait()
+	TestFramework:RunQuery(db, [[DROP TABLE IF EXISTS coalesce_duplicate_test]])
+	TestFramework:RunQuery(db, [[CREATE TABLE coalesce_duplicate_test(id INT AUTO_INCREMENT PRIMARY KEY, value INT NOT NULL UNIQUE) ENGINE=InnoDB]])
+	local finished = 0
+	local failed = 0
+	local function checkFinished()
+		if (finished + failed < 20) then return end
+		test:shouldBeEqual(failed, 1)
+		local data = TestFramework:RunQuery(db, "SELECT COUNT(*) as count FROM coalesce_duplicate_test")
+		test:shouldBeEqual(data[1].count, 19)
+		test:Complete()
+	end
+	for i = 1, 20 do
+		local qu = db:prepare("INSERT INTO coalesce_duplicate_test (value) VALUES (?)")
+		// The 11th insert repeats the value of the 10th one
+		qu:setNumber(1, (i == 11) and 10 or i)
+		function qu:onSuccess()
+			finished = finished + 1
+			checkFinished()
+		end
+		function qu:onError()
+			failed = failed + 1
+			checkFinished()
+		end
+		qu:start()
+	end
+end)
+
+TestFramework:RegisterTest("[Prepared Query] don't merge queued inserts that set the auto increment column", function(test)
+	local db = mysqloo.connect(DatabaseSettings.Host, DatabaseSettings.Username, DatabaseSettings.Password, DatabaseSettings.Database, DatabaseSettings.Port)
+	db:setCoalesceInserts(true)
+	db:connect()
+	db:wait()
+	TestFramework:RunQuery(db, [[DROP TABLE IF EXISTS coalesce_explicit_test]])
+	TestFramework:RunQuery(db, [[CREATE TABLE coalesce_explicit_test(id INT AUTO_INCREMENT PRIMARY KEY, value INT NOT NULL)]])
+	// Explicit ids mixed with generated ones, the generated ids follow the highest explicit id
+	local ids = {100, nil, 200, nil, 50}
+	local expectedIds = {100, 101, 200, 201, 50}
+	local finished = 0
+	for i = 1, 5 do
+		local qu = db:prepare("INSERT INTO coalesce_explicit_test (id, value) VALUES (?, ?)")
+		if (ids[i]) then
+			qu:setNumber(1, ids[i])
+		else
+			qu:setNull(1)
+		end
+		qu:setNumber(2, i)
+		function qu:onSuccess()
+			test:shouldBeEqual(qu:affectedRows(), 1)
+			test:shouldBeEqual(qu:lastInsert(), expectedIds[i])
+			finished = finished + 1
+			if (finished == 5) then
+				test:Complete()
+			end
+		end
+		qu:start()
+	end
+end)
+
+TestFramework:RegisterTest("[Prepared Query] insert batched parameters with multi row inserts if enabled", function(test)
+	local db = mysqloo.connect(DatabaseSettings.Host, DatabaseSettings.Username, DatabaseSettings.Password, DatabaseSettings.Database, DatabaseSettings.Port)
+	db:setBulkInserts(true)
+	db:connect()
+	db:wait()
+	TestFramework:RunQuery(db, [[DROP TABLE IF EXISTS bulk_insert_test]])
+	TestFramework:RunQuery(db, [[CREATE TABLE bulk_insert_test(id INT AUTO_INCREMENT PRIMARY KEY, value VARCHAR(10))]])
+	// The insert ids have to follow the increment of the session, even if it changed after connecting
+	TestFramework:RunQuery(db, [[SET SESSION auto_increment_increment = 2]])
+	local qu = db:prepare("INSERT INTO bulk_insert_test (value) VALUES (?)")
+	for i = 1, 1500 do
+		if (i > 1) then
+			qu:putNewParameters()
+		end
+		qu:setString(1, tostring(i * 2 - 1))
+	end
+	function qu:onSuccess()
+		for i = 1, 1500 do
+			test:shouldBeEqual(qu:affectedRows(), 1)
+			test:shouldBeEqual(qu:lastInsert(), i * 2 - 1)
+			if (i < 1500) then
+				qu:getNextResults()
+			end
+		end
+		local data = TestFramework:RunQuery(db, "SELECT COUNT(*) as count FROM bulk_insert_test WHERE id = value")
+		test:shouldBeEqual(data[1].count, 1500)
+		test:Complete()
+	end
+	qu:start()
+end)
+
+TestFramework:RegisterTest("[Prepared Query] keep the sets inserted before a failing one by default", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	TestFramework:RunQuery(db, [[DROP TABLE IF EXISTS bulk_insert_error_test]])
+	TestFramework:RunQuery(db, [[CREATE TABLE bulk_insert_error_test(id INT AUTO_INCREMENT PRIMARY KEY, value INT NOT NULL)]])
+	local qu = db:prepare("INSERT INTO bulk_insert_error_test (value) VALUES (?)")
+	qu:setNumber(1, 1)
+	qu:putNewParameters()
+	qu:setNumber(1, 2)
+	qu:putNewParameters()
+	qu:setNull(1)
+	function qu:onError()
+		local data = TestFramework:RunQuery(db, "SELECT COUNT(*) as count FROM bulk_insert_error_test")
+		test:shouldBeEqual(data[1].count, 2)
+		test:Complete()
+	end
+	function qu:onSuccess()
+		test:Fail("Inserting NULL into a NOT NULL column should fail")
+	end
+	qu:start()
+end)
+
+TestFramework:RegisterTest("[Prepared Query] return the explicit ids of batched inserts", function(test)
+	local db = mysqloo.connect(DatabaseSettings.Host, DatabaseSettings.Username, DatabaseSettings.Password, DatabaseSettings.Database, DatabaseSettings.Port)
+	db:setBulkInserts(true)
+	db:connect()
+	db:wait()
+	TestFramework:RunQuery(db, [[DROP TABLE IF EXISTS bulk_insert_explicit_test]])
+	TestFramework:RunQuery(db, [[CREATE TABLE bulk_insert_explicit_test(id INT AUTO_INCREMENT PRIMARY KEY, value INT NOT NULL)]])
+	local qu = db:prepare("INSERT INTO bulk_insert_explicit_test (id, value) VALUES (?, ?)")
+	qu:setNumber(1, 100)
+	qu:setNumber(2, 1)
+	qu:putNewParameters()
+	qu:setNull(1)
+	qu:setNumber(2, 2)
+	qu:putNewParameters()
+	qu:setNumber(1, 50)
+	qu:setNumber(2, 3)
+	function qu:onSuccess()
+		local ids = {100, 101, 50}
+		for i = 1, 3 do
+			test:shouldBeEqual(qu:lastInsert(), ids[i])
+			if (i < 3) then
+				qu:getNextResults()
+			end
+		end
+		test:Complete()
+	end
+	qu:start()
+end)
+
+TestFramework:RegisterTest("[Prepared Query] share cached statements between queries with the same sql", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	for i = 1, 3 do
+		local qu = db:prepare("SELECT ? AS value")
+		qu:setNumber(1, i)
+		qu:start()
+		qu:wait()
+		test:shouldBeEqual(qu:getData()[1].value, i)
+	end
+	local hits, misses = db:statementCacheStats()
+	test:shouldBeEqual(hits, 2)
+	test:shouldBeEqual(misses, 1)
+	test:Complete()
+end)
+
+TestFramework:RegisterTest("[Prepared Query] reuse the buffers of cached statements for longer values", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	for _, length in ipairs({1, 100, 10000, 5}) do
+		local qu = db:prepare("SELECT ? AS value, ? AS number")
+		qu:setString(1, string.rep("a", length))
+		qu:setNumber(2, length)
+		qu:start()
+		qu:wait()
+		local data = qu:getData()
+		test:shouldBeEqual(data[1].value, string.rep("a", length))
+		test:shouldBeEqual(data[1].number, length)
+	end
+	test:Complete()
+end)
+
+TestFramework:RegisterTest("[Prepared Query] fail if a parameter index is too high", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	local qu = db:prepare("SELECT ? AS value")
+	qu:setNumber(1, 1)
+	qu:setNumber(2, 2)
+	function qu:onError(err)
+		test:shouldBeEqual(err, "Invalid parameter index 2")
+		test:Complete()
+	end
+	function qu:onSuccess()
+		test:Fail("Query should have failed because of the invalid parameter index")
+	end
+	qu:start()
+end)
+
+TestFramework:RegisterTest("[Prepared Query] set parameters from tables", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	TestFramework:RunQuery(db, [[DROP TABLE IF EXISTS parameter_table_test]])
+	TestFramework:RunQuery(db, [[CREATE TABLE parameter_table_test(id INT PRIMARY KEY, name VARCHAR(10), flag BOOL)]])
+	local qu = db:prepare("INSERT INTO parameter_table_test (id, name, flag) VALUES (?, ?, ?)")
+	qu:setParameters({1, "one", true})
+	qu:addParameterRows({{2, "two", false}, {3, nil, true}})
+	qu:start()
+	qu:wait()
+	local data = TestFramework:RunQuery(db, "SELECT * FROM parameter_table_test ORDER BY id")
+	test:shouldBeEqual(#data, 3)
+	test:shouldBeEqual(data[1].name, "one")
+	test:shouldBeEqual(data[2].flag, 0)
+	test:shouldBeEqual(data[3].name, nil)
+	test:shouldBeEqual(data[3].flag, 1)
+	local select = db:prepare("SELECT ? AS a, ? AS b")
+	select:setParameters({5, "x"})
+	select:setParameters({6})
+	select:start()
+	select:wait()
+	test:shouldBeEqual(select:getData()[1].a, 6)
+	test:shouldBeEqual(select:getData()[1].b, nil)
+	test:Complete()
+end)
@@ -284,4 +284,164 @@ TestFramework:RegisterTest("[Query] Return correct values for bit fields", funct
 	qu2:start()
 	qu3:start()
 	qu4:start()
-end)
\ No newline at end of file
+end)
+TestFramework:RegisterTest("[Query] stream results to onData if enabled", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	local qu = db:query("WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM seq WHERE n < 2500) SELECT n FROM seq")
+	qu:setOption(mysqloo.OPTION_STREAM_RESULTS)
+	local callCount = 0
+	local sum = 0
+	function qu:onSuccess(data)
+		test:shouldHaveLength(data, 0)
+		test:shouldBeEqual(callCount, 2500)
+		test:shouldBeEqual(sum, 2500 * 2501 / 2)
+		test:Complete()
+	end
+	function qu:onData(row)
+		callCount = callCount + 1
+		sum = sum + row.n
+	end
+	qu:start()
+end)
+
+TestFramework:RegisterTest("[Query] pass on all streamed rows while waiting for a query", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	//More chunks than a streaming query may buffer before it waits for the main thread
+	local qu = db:query("WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM seq WHERE n < 100) SELECT a.n FROM seq a, seq b")
+	qu:setOption(mysqloo.OPTION_STREAM_RESULTS)
+	local callCount = 0
+	function qu:onData(row)
+		callCount = callCount + 1
+	end
+	function qu:onSuccess()
+		test:shouldBeEqual(callCount, 10000)
+		test:Complete()
+	end
+	qu:start()
+	local qu2 = db:query("SELECT 1 AS x")
+	qu2:start()
+	qu2:wait()
+	test:shouldBeEqual(qu2:getData()[1].x, 1)
+end)
+
+TestFramework:RegisterTest("[Query] run queued queries with a higher priority first", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	local order = {}
+	local qu = db:query("SELECT SLEEP(0.2)") //Keeps the connection busy while the other queries are queued
+	function qu:onSuccess()
+		table.insert(order, "sleep")
+	end
+	local qu2 = db:query("SELECT 1")
+	qu2:setPriority(mysqloo.PRIORITY_LOW)
+	function qu2:onSuccess()
+		table.insert(order, "low")
+		test:shouldBeEqual(table.concat(order, ","), "sleep,high,low")
+		test:Complete()
+	end
+	local qu3 = db:query("SELECT 1")
+	qu3:setPriority(mysqloo.PRIORITY_HIGH)
+	function qu3:onSuccess()
+		table.insert(order, "high")
+	end
+	qu:start()
+	timer.Simple(0.05, function()
+		qu2:start()
+		qu3:start()
+	end)
+end)
+
+TestFramework:RegisterTest("[Query] expire queries that waited in the queue for too long", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	local qu = db:query("SELECT SLEEP(0.3)") //Keeps the connection busy until the next query has expired
+	qu:start()
+	local qu2 = db:query("SELECT 1")
+	qu2:setMaxQueueTime(0.1)
+	function qu2:onSuccess()
+		test:shouldBeEqual(true, false)
+	end
+	function qu2:onError(err)
+		test:shouldBeEqual(err, "Query expired before it could be run")
+		test:shouldBeEqual(qu2:getData(), nil)
+		test:Complete()
+	end
+	qu2:start()
+end)
+
+TestFramework:RegisterTest("[Query] await queries from coroutines", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	local success = pcall(function() db:queryAsync("SELECT 1") end)
+	test:shouldBeEqual(success, false)
+	coroutine.wrap(function()
+		local data = db:queryAsync("SELECT 1 AS a")
+		test:shouldBeEqual(data[1].a, 1)
+		local qu = db:prepare("SELECT ? AS b")
+		qu:setNumber(1, 2)
+		data = qu:await()
+		test:shouldBeEqual(data[1].b, 2)
+		local result, err = db:queryAsync("SELEC 1")
+		test:shouldBeNil(result)
+		test:shouldNotBeNil(err)
+		local transaction = db:createTransaction()
+		transaction:addQuery(db:query("SELECT 3 AS c"))
+		data = transaction:await()
+		test:shouldBeEqual(data[1][1].c, 3)
+		test:Complete()
+	end)()
+end)
+
+TestFramework:RegisterTest("[Query] convert rows lazily if enabled", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	local qu = db:query("SELECT 1 AS id, 'a' AS name, NULL AS empty UNION ALL SELECT 2, 'b', NULL")
+	qu:setOption(mysqloo.OPTION_LAZY_ROWS)
+	function qu:onSuccess(data)
+		test:shouldBeEqual(#data, 2)
+		test:shouldBeEqual(data[1].id, 1)
+		test:shouldBeEqual(data[2].name, "b")
+		test:shouldBeNil(data[1].empty)
+		test:shouldBeNil(data[1].missing)
+		test:shouldBeNil(data[3])
+		test:shouldBeEqual(data[1], data[1])
+		local ids = 0
+		for i = 1, #data do
+			ids = ids + data[i].id
+		end
+		test:shouldBeEqual(ids, 3)
+		test:Complete()
+	end
+	qu:start()
+end)
+
+TestFramework:RegisterTest("[Query] return columns if columnar results are enabled", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	local qu = db:query("SELECT 1 AS id, 'a' AS name, NULL AS empty UNION ALL SELECT 2, 'b', NULL")
+	qu:setOption(mysqloo.OPTION_COLUMNAR)
+	local rows = 0
+	function qu:onData(row)
+		rows = rows + 1
+		test:shouldBeEqual(row.id, rows)
+	end
+	function qu:onSuccess(data)
+		test:shouldBeEqual(rows, 2)
+		test:shouldHaveLength(data.id, 2)
+		test:shouldBeEqual(data.id[2], 2)
+		test:shouldBeEqual(data.name[1], "a")
+		test:shouldHaveLength(data.empty, 0)
+		test:shouldBeNil(data[1])
+		test:Complete()
+	end
+	qu:start()
+end)
+
+TestFramework:RegisterTest("[Query] pin the result set with getRawResult", function(test)
+	local db = TestFramework:ConnectToDatabase()
+	local qu = db:query("SELECT 1 AS id UNION ALL SELECT 2")
+	test:shouldBeNil(qu:getRawResult())
+	function qu:onSuccess()
+		local handle = qu:getRawResult()
+		test:shouldNotBeNil(handle)
+		test:shouldHaveLength(handle, 2)
+		test:shouldBeEqual(type(handle:address()), "number")
+		test:Complete()
+	end
+	qu:start()
+end)
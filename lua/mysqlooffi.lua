@@ -0,0 +1,161 @@
+--[==[
+	This library reads the results of mysqloo queries through the LuaJIT ffi, without creating a lua table per row.
+	It requires the ffi library, which is not available to lua in a default Garry's Mod installation.
+	Function overview:
+
+	mysqloo.GetRawResult(query)
+		Returns: a raw result reader or nil if the query has no data (same as query:getData())
+		The reader keeps the result set alive, the query can be reused while the reader is in use
+
+	Rows and columns are indexed starting with 1, just like in query:getData()
+
+	RawResult:RowCount()
+	RawResult:ColumnCount()
+	RawResult:ColumnName(column)
+	RawResult:ColumnIndex(name)
+		Returns: the index of the column with the given name or nil (the last column if several have the same name)
+	RawResult:IsNull(row, column)
+	RawResult:GetNumber(row, column)
+		Returns: the value of a numeric column, nil if the column is not numeric or the value is NULL
+	RawResult:GetPointer(row, column)
+		Returns: a const char* to the value and its length, the pointer is only valid while the reader is alive
+		Numeric values of prepared queries don't have a string value, use GetNumber for those
+	RawResult:GetString(row, column)
+	RawResult:GetValue(row, column)
+		Returns: the value of the cell as it would be returned by query:getData()
+
+	Example:
+		local result = mysqloo.GetRawResult(query)
+		local idColumn = result:ColumnIndex("id")
+		local sum = 0
+		for i = 1, result:RowCount() do
+			sum = sum + result:GetNumber(i, idColumn)
+		end
+]==]
+
+require("mysqloo")
+local ffi = ffi
+if (!ffi) then
+	local success, module = pcall(require, "ffi")
+	ffi = (success and module) or (package.loaded and package.loaded.ffi)
+end
+if (!ffi) then
+	MsgC(Color(255, 0, 0), "mysqlooffi requires the LuaJIT ffi library, which is not available\n")
+	return
+end
+
+-- Has to match RawResult and RawResultColumn of ResultData.h
+-- Types can't be redefined, so they are only declared the first time this file is loaded
+if (!pcall(ffi.typeof, "mysqloo_raw_result")) then
+ffi.cdef[[
+typedef struct {
+	const char *name;
+	size_t nameLength;
+	int type;
+	int isNumeric;
+	const size_t *offsets;
+	const size_t *lengths;
+	const uint8_t *nullBitmap;
+	const double *numbers;
+} mysqloo_raw_column;
+
+typedef struct {
+	size_t rowCount;
+	unsigned int columnCount;
+	int isStoredResult;
+	const mysqloo_raw_column *columns;
+	const char *arena;
+	char **const *rows;
+	const unsigned long *rowLengths;
+} mysqloo_raw_result;
+]]
+end
+
+local MYSQL_TYPE_NULL = 6
+local band, rshift = bit.band, bit.rshift
+
+local rawResult = {}
+local rawResultMT = {__index = rawResult}
+
+function mysqloo.GetRawResult(query)
+	local handle = query:getRawResult()
+	if (!handle) then return nil end
+	return setmetatable({
+		handle = handle, -- The storage is freed once the handle is collected
+		raw = ffi.cast("const mysqloo_raw_result*", handle:address()),
+		rowCount = #handle
+	}, rawResultMT)
+end
+
+-- Reading outside of the result set would read arbitrary memory
+local function checkCell(self, row, column)
+	if (row < 1 or row > self.rowCount or column < 1 or column > self.raw.columnCount) then
+		error("Cell " .. tostring(row) .. ", " .. tostring(column) .. " is outside of the result set", 3)
+	end
+end
+
+function rawResult:RowCount()
+	return self.rowCount
+end
+
+function rawResult:ColumnCount()
+	return self.raw.columnCount
+end
+
+function rawResult:ColumnName(column)
+	if (column < 1 or column > self.raw.columnCount) then return nil end
+	local rawColumn = self.raw.columns[column - 1]
+	return ffi.string(rawColumn.name, rawColumn.nameLength)
+end
+
+function rawResult:ColumnIndex(name)
+	if (!self.columnIndices) then
+		self.columnIndices = {}
+		for i = 1, self:ColumnCount() do
+			self.columnIndices[self:ColumnName(i)] = i
+		end
+	end
+	return self.columnIndices[name]
+end
+
+function rawResult:IsNull(row, column)
+	checkCell(self, row, column)
+	local raw = self.raw
+	local rawColumn = raw.columns[column - 1]
+	if (rawColumn.type == MYSQL_TYPE_NULL) then return true end
+	if (raw.isStoredResult != 0) then
+		return raw.rows[row - 1][column - 1] == nil
+	end
+	return band(rshift(rawColumn.nullBitmap[rshift(row - 1, 3)], (row - 1) % 8), 1) == 1
+end
+
+function rawResult:GetNumber(row, column)
+	if (self:IsNull(row, column)) then return nil end
+	local rawColumn = self.raw.columns[column - 1]
+	if (rawColumn.isNumeric == 0) then return nil end
+	return rawColumn.numbers[row - 1]
+end
+
+function rawResult:GetPointer(row, column)
+	checkCell(self, row, column)
+	local raw = self.raw
+	if (raw.isStoredResult != 0) then
+		local index = (row - 1) * raw.columnCount + (column - 1)
+		return raw.rows[row - 1][column - 1], tonumber(raw.rowLengths[index])
+	end
+	local rawColumn = raw.columns[column - 1]
+	return raw.arena + rawColumn.offsets[row - 1], tonumber(rawColumn.lengths[row - 1])
+end
+
+function rawResult:GetString(row, column)
+	if (self:IsNull(row, column)) then return nil end
+	return ffi.string(self:GetPointer(row, column))
+end
+
+function rawResult:GetValue(row, column)
+	checkCell(self, row, column)
+	if (self.raw.columns[column - 1].isNumeric != 0) then
+		return self:GetNumber(row, column)
+	end
+	return self:GetString(row, column)
+end
@@ -155,6 +155,11 @@ local function setPreparedQueryArguments(query, values)
 	if (type(values) != "table") then
 		values = { values }
 	end
+	if (query.setParameters) then
+		query:setParameters(values)
+		return
+	end
+	-- Fallback for versions of mysqloo without setParameters
 	local typeFunctions = {
 		["string"] = function(query, index, value) query:setString(index, value) end,
 		["number"] = function(query, index, value) query:setNumber(index, value) end,
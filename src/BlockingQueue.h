@@ -5,24 +5,30 @@
 #include <mutex>
 #include <condition_variable>
 #include <algorithm>
+#include <functional>
 
 template<typename T>
 class BlockingQueue {
 public:
     void put(T elem) {
+        bool hasWaitingConsumer;
         {
-            std::lock_guard<std::recursive_mutex> lock(mutex);
-            backingQueue.push_back(elem);
+            std::lock_guard<std::mutex> lock(mutex);
+            backingQueue.push_back(std::move(elem));
+            hasWaitingConsumer = waitingConsumers > 0;
+        }
+        //Only wake a consumer up if one is actually parked, otherwise the notify is a wasted syscall
+        if (hasWaitingConsumer) {
+            waitObj.notify_one();
         }
-        waitObj.notify_all();
     }
 
     bool empty() {
         return size() == 0;
     }
 
-    bool swapToFrontIf(std::function<bool(T)> func) {
-        std::lock_guard<std::recursive_mutex> lock(mutex);
+    bool swapToFrontIf(const std::function<bool(const T &)> &func) {
+        std::lock_guard<std::mutex> lock(mutex);
         auto pos = std::find_if(backingQueue.begin(), backingQueue.end(), func);
         if (pos != backingQueue.begin() && pos != backingQueue.end()) {
             std::iter_swap(pos, backingQueue.begin());
@@ -31,43 +37,59 @@ public:
         return false;
     }
 
-    bool removeIf(std::function<bool(T)> func) {
-        std::lock_guard<std::recursive_mutex> lock(mutex);
+    bool removeIf(const std::function<bool(const T &)> &func) {
+        std::lock_guard<std::mutex> lock(mutex);
         auto it = std::remove_if(backingQueue.begin(), backingQueue.end(), func);
         bool removed = it != backingQueue.end();
         backingQueue.erase(it, backingQueue.end());
         return removed;
     }
 
-    void remove(T elem) {
-        std::lock_guard<std::recursive_mutex> lock(mutex);
+    void remove(const T &elem) {
+        std::lock_guard<std::mutex> lock(mutex);
         backingQueue.erase(std::remove(backingQueue.begin(), backingQueue.end(), elem), backingQueue.end());
     }
 
     size_t size() {
-        std::lock_guard<std::recursive_mutex> lock(mutex);
+        std::lock_guard<std::mutex> lock(mutex);
         return backingQueue.size();
     }
 
     T take() {
-        std::unique_lock<std::recursive_mutex> lock(mutex);
-        waitObj.wait(lock, [this] { return this->size() > 0; });
-        auto front = backingQueue.front();
+        std::unique_lock<std::mutex> lock(mutex);
+        if (backingQueue.empty()) {
+            waitingConsumers++;
+            waitObj.wait(lock, [this] { return !this->backingQueue.empty(); });
+            waitingConsumers--;
+        }
+        T front = std::move(backingQueue.front());
         backingQueue.pop_front();
         return front;
     }
 
+    //Takes the first element without blocking, returns false if the queue is empty
+    bool tryTake(T &out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (backingQueue.empty()) {
+            return false;
+        }
+        out = std::move(backingQueue.front());
+        backingQueue.pop_front();
+        return true;
+    }
+
     std::deque<T> clear() {
-        std::lock_guard<std::recursive_mutex> lock(mutex);
-        std::deque<T> returnQueue = backingQueue;
-        backingQueue.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        std::deque<T> returnQueue;
+        returnQueue.swap(backingQueue);
         return returnQueue;
     }
 
 private:
     std::deque<T> backingQueue{};
-    std::recursive_mutex mutex{};
-    std::condition_variable_any waitObj{};
+    std::mutex mutex{};
+    std::condition_variable waitObj{};
+    unsigned int waitingConsumers = 0; //Protected by mutex
 };
 
 #endif
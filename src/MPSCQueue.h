@@ -0,0 +1,70 @@
+#ifndef MPSC_QUEUE_
+#define MPSC_QUEUE_
+
+#include <atomic>
+#include <vector>
+
+//Lock-free multi producer, single consumer queue.
+//Producers push onto an intrusive list with a single CAS, the consumer takes the entire list at once.
+//There is no way for the consumer to block on this queue, it is meant to be polled (i.e. from the think hook).
+template<typename T>
+class MPSCQueue {
+public:
+    MPSCQueue() = default;
+
+    MPSCQueue(const MPSCQueue &) = delete;
+
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    ~MPSCQueue() {
+        Node *node = head.exchange(nullptr, std::memory_order_acquire);
+        while (node != nullptr) {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    void put(T elem) {
+        auto *node = new Node{std::move(elem), head.load(std::memory_order_relaxed)};
+        while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == nullptr;
+    }
+
+    //May only be called by the consumer
+    //Moves all elements into out, in the order they were put into the queue.
+    //Elements are appended, so the caller can reuse the storage of out across calls.
+    template<typename Container = std::vector<T>>
+    void takeAll(Container &out) {
+        if (head.load(std::memory_order_relaxed) == nullptr) return;
+        Node *node = head.exchange(nullptr, std::memory_order_acquire);
+        //The list is linked newest first, so it needs to be reversed
+        Node *reversed = nullptr;
+        while (node != nullptr) {
+            Node *next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+        while (reversed != nullptr) {
+            Node *next = reversed->next;
+            out.push_back(std::move(reversed->value));
+            delete reversed;
+            reversed = next;
+        }
+    }
+
+private:
+    struct Node {
+        T value;
+        Node *next;
+    };
+
+    std::atomic<Node *> head{nullptr};
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef PRIORITY_QUEUE_
+#define PRIORITY_QUEUE_
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+/* Thread safe queue with a fixed amount of priority levels, elements of the same level are taken in fifo order.
+ * To prevent starvation, a non empty level is served after it was skipped in favor of higher levels maxSkips times.
+ * Elements that are put with putLast are only taken once all levels are empty.
+ */
+template<typename T, size_t Levels>
+class PriorityQueue {
+public:
+    explicit PriorityQueue(unsigned int maxSkips) : maxSkips(maxSkips) {
+    }
+
+    void put(T elem, size_t level) {
+        std::lock_guard<std::mutex> lock(mutex);
+        levels[std::min(level, Levels - 1)].push_back(std::move(elem));
+    }
+
+    void putLast(T elem) {
+        std::lock_guard<std::mutex> lock(mutex);
+        lastElements.push_back(std::move(elem));
+    }
+
+    bool empty() {
+        return size() == 0;
+    }
+
+    //Moves the first matching element to the front of the highest level, so it is taken next
+    bool swapToFrontIf(const std::function<bool(const T &)> &func) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto &highestLevel = levels[Levels - 1];
+        for (auto &level: levels) {
+            auto pos = std::find_if(level.begin(), level.end(), func);
+            if (pos == level.end()) continue;
+            if (&level == &highestLevel && pos == level.begin()) {
+                return false;
+            }
+            T elem = std::move(*pos);
+            level.erase(pos);
+            highestLevel.push_front(std::move(elem));
+            return true;
+        }
+        return false;
+    }
+
+    bool removeIf(const std::function<bool(const T &)> &func) {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool removed = false;
+        for (size_t i = 0; i < Levels; i++) {
+            auto &level = levels[i];
+            auto it = std::remove_if(level.begin(), level.end(), func);
+            removed |= it != level.end();
+            level.erase(it, level.end());
+            if (level.empty()) {
+                skipCounts[i] = 0;
+            }
+        }
+        return removed;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t size = lastElements.size();
+        for (auto &level: levels) {
+            size += level.size();
+        }
+        return size;
+    }
+
+    //Takes the next element without blocking, returns false if the queue is empty
+    bool tryTake(T &out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return takeNext(out, nullptr);
+    }
+
+    //Takes the next element only if it matches, returns false if the queue is empty or it didn't match
+    bool tryTakeIf(T &out, const std::function<bool(const T &)> &func) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return takeNext(out, &func);
+    }
+
+    //Removes all elements, ordered by the order they would have been taken in if no level was starving
+    std::deque<T> clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::deque<T> returnQueue;
+        for (size_t i = Levels; i-- > 0;) {
+            std::move(levels[i].begin(), levels[i].end(), std::back_inserter(returnQueue));
+            levels[i].clear();
+            skipCounts[i] = 0;
+        }
+        std::move(lastElements.begin(), lastElements.end(), std::back_inserter(returnQueue));
+        lastElements.clear();
+        return returnQueue;
+    }
+
+private:
+    //Needs to be called with the mutex locked
+    bool takeNext(T &out, const std::function<bool(const T &)> *func) {
+        size_t chosenLevel = Levels;
+        for (size_t i = Levels; i-- > 0;) {
+            if (levels[i].empty()) continue;
+            if (chosenLevel == Levels) {
+                chosenLevel = i;
+            } else if (skipCounts[i] >= maxSkips) {
+                //A lower level that has been waiting for too long
+                chosenLevel = i;
+                break;
+            }
+        }
+        auto &chosenQueue = (chosenLevel == Levels) ? lastElements : levels[chosenLevel];
+        if (chosenQueue.empty() || (func != nullptr && !(*func)(chosenQueue.front()))) {
+            return false;
+        }
+        if (chosenLevel != Levels) {
+            for (size_t i = 0; i < chosenLevel; i++) {
+                if (!levels[i].empty()) {
+                    skipCounts[i]++;
+                }
+            }
+            skipCounts[chosenLevel] = 0;
+        }
+        out = std::move(chosenQueue.front());
+        chosenQueue.pop_front();
+        return true;
+    }
+
+    std::array<std::deque<T>, Levels> levels{};
+    std::array<unsigned int, Levels> skipCounts{}; //How often a non empty level was skipped since it was last served
+    std::deque<T> lastElements{};
+    unsigned int maxSkips;
+    std::mutex mutex{};
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "GarrysMod/Lua/Interface.h"
 #include "../mysql/Database.h"
+#include "../mysql/ConnectionPoller.h"
 #include <iostream>
 #include <fstream>
 #include "LuaObject.h"
@@ -7,6 +8,8 @@
 #include "LuaTransaction.h"
 #include "LuaQuery.h"
 #include "LuaPreparedQuery.h"
+#include "LuaLazyResult.h"
+#include "LuaRawResult.h"
 
 #define MYSQLOO_VERSION "9"
 #define MYSQLOO_MINOR_VERSION "7"
@@ -20,6 +23,10 @@ GMOD_MODULE_CLOSE() {
         LuaReferenceFree(LUA, versionCheckConVar);
         versionCheckConVar = 0;
     }
+    //The scheduler threads use the mysql library, so they have to be stopped before it is shut down
+    //Connections waiting for the server are handed back to the scheduler first, so they are finished by its threads
+    ConnectionPoller::getInstance().shutdown();
+    ConnectionScheduler::getInstance().shutdown();
     mysql_thread_end();
     mysql_library_end();
 
@@ -144,6 +151,16 @@ LUA_FUNCTION(referenceFreedCount) {
     return 1;
 }
 
+LUA_FUNCTION(setThinkBudget) {
+    LUA->CheckType(1, GarrysMod::Lua::Type::Number);
+    double budget = LUA->GetNumber(1);
+    if (budget < 0 || budget > 1000) {
+        LUA->ThrowError("Think budget must be between 0 and 1000 milliseconds");
+    }
+    LuaDatabase::thinkBudget = budget;
+    return 0;
+}
+
 LUA_FUNCTION(mysqlooThink) {
     LUA->PushSpecial(GarrysMod::Lua::SPECIAL_GLOB);
     LUA->GetField(-1, "mysqloo");
@@ -163,10 +180,13 @@ GMOD_MODULE_OPEN() {
 
     //Creating MetaTables
     LuaObject::createUserDataMetaTable(LUA);
+    LuaLazyResult::createMetaTables(LUA);
+    LuaRawResult::createMetaTable(LUA);
     LuaDatabase::createMetaTable(LUA);
     LuaQuery::createMetaTable(LUA);
     LuaPreparedQuery::createMetaTable(LUA);
     LuaTransaction::createMetaTable(LUA);
+    LuaIQuery::createAwaitFunctions(LUA);
 
     LUA->PushSpecial(GarrysMod::Lua::SPECIAL_GLOB);
     LUA->GetField(-1, "hook");
@@ -213,6 +233,19 @@ GMOD_MODULE_OPEN() {
     LUA->SetField(-2, "OPTION_NAMED_FIELDS"); //Not used anymore
     LUA->PushNumber(OPTION_CACHE);
     LUA->SetField(-2, "OPTION_CACHE"); //Not used anymore
+    LUA->PushNumber(OPTION_STREAM_RESULTS);
+    LUA->SetField(-2, "OPTION_STREAM_RESULTS");
+    LUA->PushNumber(OPTION_LAZY_ROWS);
+    LUA->SetField(-2, "OPTION_LAZY_ROWS");
+    LUA->PushNumber(OPTION_COLUMNAR);
+    LUA->SetField(-2, "OPTION_COLUMNAR");
+
+    LUA->PushNumber(PRIORITY_LOW);
+    LUA->SetField(-2, "PRIORITY_LOW");
+    LUA->PushNumber(PRIORITY_NORMAL);
+    LUA->SetField(-2, "PRIORITY_NORMAL");
+    LUA->PushNumber(PRIORITY_HIGH);
+    LUA->SetField(-2, "PRIORITY_HIGH");
 
     LUA->PushNumber(SSL_MODE_DISABLED);
     LUA->SetField(-2, "SSL_MODE_DISABLED");
@@ -227,6 +260,8 @@ GMOD_MODULE_OPEN() {
 
     LUA->PushCFunction(LuaDatabase::create);
     LUA->SetField(-2, "connect");
+    LUA->PushCFunction(setThinkBudget);
+    LUA->SetField(-2, "setThinkBudget");
 
     //Debug/testing functions
     LUA->PushCFunction(objectCount);
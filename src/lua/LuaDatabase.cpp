@@ -176,6 +176,17 @@ MYSQLOO_LUA_FUNCTION(setReadTimeout) {
     return 0;
 }
 
+MYSQLOO_LUA_FUNCTION(setMaxQueueTime) {
+    auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
+    LUA->CheckType(2, GarrysMod::Lua::Type::Number);
+    double seconds = LUA->GetNumber(2);
+    if (seconds < 0) {
+        LUA->ThrowError("Max queue time must not be negative");
+    }
+    database->m_database->setMaxQueueTime(std::chrono::milliseconds((long long) (seconds * 1000)));
+    return 0;
+}
+
 MYSQLOO_LUA_FUNCTION(setWriteTimeout) {
     auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
     unsigned int timeout = (int) LUA->GetNumber(2);
@@ -254,11 +265,49 @@ MYSQLOO_LUA_FUNCTION(setCachePreparedStatements) {
     return 0;
 }
 
+MYSQLOO_LUA_FUNCTION(setCoalesceInserts) {
+    auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
+    LUA->CheckType(2, GarrysMod::Lua::Type::Bool);
+    database->m_database->setCoalesceInserts(LUA->GetBool(2));
+    return 0;
+}
+
+MYSQLOO_LUA_FUNCTION(setBulkInserts) {
+    auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
+    LUA->CheckType(2, GarrysMod::Lua::Type::Bool);
+    database->m_database->setBulkInserts(LUA->GetBool(2));
+    return 0;
+}
+
+MYSQLOO_LUA_FUNCTION(setStatementCacheSize) {
+    auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
+    LUA->CheckType(2, GarrysMod::Lua::Type::Number);
+    int size = (int) LUA->GetNumber(2);
+    if (size < 1) {
+        LUA->ThrowError("Statement cache size must be at least 1");
+    }
+    database->m_database->setStatementCacheSize((unsigned int) size);
+    return 0;
+}
+
+MYSQLOO_LUA_FUNCTION(setConnectionCount) {
+    auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
+    LUA->CheckType(2, GarrysMod::Lua::Type::Number);
+    int count = (int) LUA->GetNumber(2);
+    if (count < 1) {
+        LUA->ThrowError("Connection count must be at least 1");
+    }
+    database->m_database->setConnectionCount((unsigned int) count);
+    return 0;
+}
+
 MYSQLOO_LUA_FUNCTION(abortAllQueries) {
     auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
     auto abortedQueries = database->m_database->abortAllQueries();
     for (const auto &pair: abortedQueries) {
-        if (auto transaction = std::dynamic_pointer_cast<Transaction>(pair.first)) {
+        if (LuaIQuery::resumeAwaitingCoroutine(LUA, pair.first, pair.second)) {
+            //The results are passed to the coroutine instead
+        } else if (auto transaction = std::dynamic_pointer_cast<Transaction>(pair.first)) {
             LuaTransaction::runAbortedCallback(LUA, transaction, std::dynamic_pointer_cast<TransactionData>(pair.second));
         } else {
             LuaIQuery::runAbortedCallback(LUA, pair.second);
@@ -269,12 +318,31 @@ MYSQLOO_LUA_FUNCTION(abortAllQueries) {
     return 1;
 }
 
+MYSQLOO_LUA_FUNCTION(callbackBacklog) {
+    auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
+    LUA->PushNumber((double) database->getCallbackBacklog());
+    return 1;
+}
+
 MYSQLOO_LUA_FUNCTION(queueSize) {
     auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
     LUA->PushNumber((double) database->m_database->queueSize());
     return 1;
 }
 
+MYSQLOO_LUA_FUNCTION(statementCacheStats) {
+    auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
+    LUA->PushNumber((double) database->m_database->statementCacheHitCount());
+    LUA->PushNumber((double) database->m_database->statementCacheMissCount());
+    return 2;
+}
+
+MYSQLOO_LUA_FUNCTION(parkedQueryCount) {
+    auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
+    LUA->PushNumber((double) database->m_database->parkedQueryCount());
+    return 1;
+}
+
 MYSQLOO_LUA_FUNCTION(ping) {
     auto database = LuaObject::getLuaObject<LuaDatabase>(LUA);
     LUA->PushBool(database->m_database->ping());
@@ -316,6 +384,9 @@ void LuaDatabase::createMetaTable(ILuaBase *LUA) {
     LUA->PushCFunction(setConnectTimeout);
     LUA->SetField(-2, "setConnectTimeout");
 
+    LUA->PushCFunction(setMaxQueueTime);
+    LUA->SetField(-2, "setMaxQueueTime");
+
     LUA->PushCFunction(disconnect);
     LUA->SetField(-2, "disconnect");
 
@@ -340,12 +411,33 @@ void LuaDatabase::createMetaTable(ILuaBase *LUA) {
     LUA->PushCFunction(setCachePreparedStatements);
     LUA->SetField(-2, "setCachePreparedStatements");
 
+    LUA->PushCFunction(setCoalesceInserts);
+    LUA->SetField(-2, "setCoalesceInserts");
+
+    LUA->PushCFunction(setBulkInserts);
+    LUA->SetField(-2, "setBulkInserts");
+
+    LUA->PushCFunction(setStatementCacheSize);
+    LUA->SetField(-2, "setStatementCacheSize");
+
+    LUA->PushCFunction(setConnectionCount);
+    LUA->SetField(-2, "setConnectionCount");
+
     LUA->PushCFunction(abortAllQueries);
     LUA->SetField(-2, "abortAllQueries");
 
     LUA->PushCFunction(queueSize);
     LUA->SetField(-2, "queueSize");
 
+    LUA->PushCFunction(callbackBacklog);
+    LUA->SetField(-2, "callbackBacklog");
+
+    LUA->PushCFunction(statementCacheStats);
+    LUA->SetField(-2, "statementCacheStats");
+
+    LUA->PushCFunction(parkedQueryCount);
+    LUA->SetField(-2, "parkedQueryCount");
+
     LUA->PushCFunction(ping);
     LUA->SetField(-2, "ping");
 
@@ -364,7 +456,9 @@ void LuaDatabase::createMetaTable(ILuaBase *LUA) {
     LUA->Pop();
 }
 
-void LuaDatabase::think(ILuaBase *LUA) {
+double LuaDatabase::thinkBudget = 0;
+
+void LuaDatabase::think(ILuaBase *LUA, std::chrono::steady_clock::time_point deadline) {
     //Connection callbacks
     auto database = this->m_database;
     if (database->isConnectionDone() && !this->m_dbCallbackRan && this->m_tableReference != 0) {
@@ -396,9 +490,34 @@ void LuaDatabase::think(ILuaBase *LUA) {
     }
 
     //Run callbacks of finished queries
-    auto finishedQueries = database->takeFinishedQueries();
-    for (auto &pair: finishedQueries) {
-        LuaQuery::runCallback(LUA, pair.first, pair.second);
+    //Entries are popped before their callback runs, since callbacks can call think again (i.e. through query:wait())
+    database->takeStreamedQueries(this->m_pendingStreamedQueries);
+    database->takeFinishedQueries(this->m_pendingCallbacks);
+    //At least one callback is run by every think, so the queries make progress even if the budget is tiny
+    bool ranCallback = false;
+    auto hasTimeLeft = [&] { return !ranCallback || std::chrono::steady_clock::now() < deadline; };
+    //Both lists take turns, so a long running stream can't hold back the callbacks of finished queries.
+    //Finished streaming queries pass on their remaining rows first, so their rows are never passed on too late.
+    bool finishedQueryTurn = true;
+    while ((!this->m_pendingStreamedQueries.empty() || !this->m_pendingCallbacks.empty()) && hasTimeLeft()) {
+        ranCallback = true;
+        bool runFinishedQuery = this->m_pendingStreamedQueries.empty() ||
+                                (finishedQueryTurn && !this->m_pendingCallbacks.empty());
+        finishedQueryTurn = !runFinishedQuery;
+        if (runFinishedQuery) {
+            auto pair = std::move(this->m_pendingCallbacks.front());
+            this->m_pendingCallbacks.pop_front();
+            LuaQuery::runCallback(LUA, pair.first, pair.second);
+        } else {
+            auto pair = std::move(this->m_pendingStreamedQueries.front());
+            this->m_pendingStreamedQueries.pop_front();
+            LuaQuery::runStreamedDataCallbacks(LUA, std::dynamic_pointer_cast<Query>(pair.first),
+                                               std::dynamic_pointer_cast<QueryData>(pair.second));
+        }
+    }
+    if (!this->m_pendingCallbacks.empty()) {
+        //onDisconnected is only called once all callbacks have been run
+        return;
     }
 
     if (database->wasDisconnected() && this->m_hasOnDisconnected && this->m_tableReference != 0) {
@@ -421,7 +540,10 @@ void LuaDatabase::onDestroyedByLua(ILuaBase *LUA) {
     m_database->disconnect(true); //Wait for any outstanding queries to finish.
     //If this is called, LUA is either reloading or no queries exist in the query queue of the database, clear it
     //This needs to be cleared to avoid the queries leaking
-    m_database->takeFinishedQueries();
+    m_database->takeStreamedQueries(m_pendingStreamedQueries);
+    m_database->takeFinishedQueries(m_pendingCallbacks);
+    m_pendingStreamedQueries.clear();
+    m_pendingCallbacks.clear();
     m_database->abortAllQueries();
 }
 
@@ -479,11 +601,32 @@ void LuaDatabase::runAllThinkHooks(ILuaBase *LUA) {
     LUA->Pop(); //__weakDatabases
 
     //Call think function of each alive database instance
-    for (auto &ref: databaseReferences) {
+    //If a think budget is set, each database gets an equal share of the time that is left when its turn comes,
+    //so time that a database did not use is passed on to the next ones.
+    //The database that goes first changes every tick, so no database is always the one running out of time.
+    static size_t firstDatabase = 0;
+    const size_t databaseCount = databaseReferences.size();
+    const auto start = std::chrono::steady_clock::now();
+    const auto budgetEnd = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(thinkBudget));
+    if (databaseCount > 0) {
+        firstDatabase = (firstDatabase + 1) % databaseCount;
+    }
+    for (size_t i = 0; i < databaseCount; i++) {
+        int ref = databaseReferences[(firstDatabase + i) % databaseCount];
         LUA->ReferencePush(ref);
         LuaReferenceFree(LUA, ref); //We can immediately free this, the variable on the stack keeps it alive.
         auto database = LuaObject::getLuaObject<LuaDatabase>(LUA, -1);
-        database->think(LUA);
+        if (thinkBudget > 0) {
+            auto now = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::duration share{0};
+            if (now < budgetEnd) {
+                share = (budgetEnd - now) / (long long) (databaseCount - i);
+            }
+            database->think(LUA, now + share);
+        } else {
+            database->think(LUA);
+        }
         LUA->Pop(); //database
     }
 }
@@ -6,6 +6,8 @@
 #include "../mysql/Database.h"
 
 #include <utility>
+#include <deque>
+#include <chrono>
 #include "LuaObject.h"
 
 class LuaDatabase : public LuaObject {
@@ -14,12 +16,18 @@ public:
 
     static int create(lua_State *L);
 
-    void think(ILuaBase *LUA);
+    //Runs callbacks until the deadline has passed, the remaining ones are run by the next think
+    void think(ILuaBase *LUA, std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    size_t getCallbackBacklog() const { return m_pendingCallbacks.size() + m_pendingStreamedQueries.size(); }
 
     int m_tableReference = 0;
     bool m_hasOnDisconnected = false;
     std::shared_ptr<Database> m_database;
     bool m_dbCallbackRan = false;
+    //Finished (or streaming) queries whose callbacks have not been run yet because the think budget was used up
+    std::deque<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> m_pendingCallbacks;
+    std::deque<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> m_pendingStreamedQueries;
 
     void onDestroyedByLua(ILuaBase *LUA) override;
 
@@ -29,6 +37,9 @@ public:
 
     static void createWeakTable(ILuaBase *LUA);
     static void runAllThinkHooks(ILuaBase *LUA);
+
+    //Time in milliseconds that the think hook may spend running callbacks per tick, 0 means unlimited
+    static double thinkBudget;
 };
 
 
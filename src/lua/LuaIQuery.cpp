@@ -8,7 +8,28 @@
 MYSQLOO_LUA_FUNCTION(start) {
     auto query = LuaIQuery::getLuaObject<LuaIQuery>(LUA);
     auto queryData = query->buildQueryData(LUA, 1, true);
-    query->m_query->start(queryData);
+    query->m_query->start(std::move(queryData));
+    return 0;
+}
+
+//Starts the query for the coroutine that is running, it is resumed by the think hook once the query is done
+MYSQLOO_LUA_FUNCTION(startAwait) {
+    auto query = LuaIQuery::getLuaObject<LuaIQuery>(LUA);
+    LUA->PushSpecial(GarrysMod::Lua::SPECIAL_GLOB);
+    LUA->GetField(-1, "coroutine");
+    LUA->GetField(-1, "running");
+    LUA->Call(0, 2);
+    //The second value is only returned with lua 5.2 compatibility and is true for the main thread
+    if (!LUA->IsType(-2, GarrysMod::Lua::Type::Thread) || LUA->GetBool(-1)) {
+        LUA->ThrowError("await can only be called from within a coroutine");
+    }
+    LUA->Pop(); //Is main thread
+    int coroutineReference = LuaReferenceCreate(LUA);
+    LUA->Pop(2); //Coroutine table, global
+    //No callbacks are referenced, the results are passed to the coroutine instead
+    auto queryData = query->buildQueryData(LUA, 1, false);
+    queryData->m_coroutineReference = coroutineReference;
+    query->m_query->start(std::move(queryData));
     return 0;
 }
 
@@ -49,6 +70,24 @@ MYSQLOO_LUA_FUNCTION(setOption) {
     return 0;
 }
 
+MYSQLOO_LUA_FUNCTION(setPriority) {
+    auto query = LuaIQuery::getLuaObject<LuaIQuery>(LUA);
+    LUA->CheckType(2, GarrysMod::Lua::Type::Number);
+    query->m_query->setPriority((int) LUA->GetNumber(2));
+    return 0;
+}
+
+MYSQLOO_LUA_FUNCTION(setMaxQueueTime) {
+    auto query = LuaIQuery::getLuaObject<LuaIQuery>(LUA);
+    LUA->CheckType(2, GarrysMod::Lua::Type::Number);
+    double seconds = LUA->GetNumber(2);
+    if (seconds < 0) {
+        LUA->ThrowError("Max queue time must not be negative");
+    }
+    query->m_query->setMaxQueueTime(std::chrono::milliseconds((long long) (seconds * 1000)));
+    return 0;
+}
+
 MYSQLOO_LUA_FUNCTION(isRunning) {
     auto query = LuaIQuery::getLuaObject<LuaIQuery>(LUA);
     LUA->PushBool(query->m_query->isRunning());
@@ -59,7 +98,9 @@ MYSQLOO_LUA_FUNCTION(abort) {
     auto query = LuaIQuery::getLuaObject<LuaIQuery>(LUA);
     auto abortedData = query->m_query->abort();
     for (auto &data: abortedData) {
-        if (auto transaction = std::dynamic_pointer_cast<Transaction>(query->m_query)) {
+        if (LuaIQuery::resumeAwaitingCoroutine(LUA, query->m_query, data)) {
+            //The results are passed to the coroutine instead
+        } else if (auto transaction = std::dynamic_pointer_cast<Transaction>(query->m_query)) {
             LuaTransaction::runAbortedCallback(LUA, transaction, std::dynamic_pointer_cast<TransactionData>(data));
         } else {
             LuaIQuery::runAbortedCallback(LUA, data);
@@ -107,12 +148,106 @@ void LuaIQuery::addMetaTableFunctions(ILuaBase *LUA) {
     LUA->SetField(-2, "wait");
     LUA->PushCFunction(setOption);
     LUA->SetField(-2, "setOption");
+    LUA->PushCFunction(setPriority);
+    LUA->SetField(-2, "setPriority");
+    LUA->PushCFunction(setMaxQueueTime);
+    LUA->SetField(-2, "setMaxQueueTime");
     LUA->PushCFunction(isRunning);
     LUA->SetField(-2, "isRunning");
     LUA->PushCFunction(abort);
     LUA->SetField(-2, "abort");
 }
 
+/* C functions can't yield through the ILuaBase interface, so the functions that yield are compiled from lua.
+ * await starts the query and yields, the think hook resumes the coroutine with the results of the query.
+ */
+static const char *AWAIT_FUNCTIONS_SOURCE = R"(
+local startAwait, yield = ...
+local function await(query)
+    startAwait(query)
+    return yield()
+end
+local function queryAsync(db, sql)
+    return await(db:query(sql))
+end
+return await, queryAsync
+)";
+
+//Adds query:await() to all query types and db:queryAsync(sql) to the database
+void LuaIQuery::createAwaitFunctions(ILuaBase *LUA) {
+    LUA->PushSpecial(GarrysMod::Lua::SPECIAL_GLOB);
+    LUA->GetField(-1, "CompileString");
+    if (!LUA->IsType(-1, GarrysMod::Lua::Type::Function)) {
+        LUA->Pop(2); //CompileString, global
+        return;
+    }
+    LUA->PushString(AWAIT_FUNCTIONS_SOURCE);
+    LUA->PushString("mysqloo/await");
+    LUA->Call(2, 1);
+    LUA->PushCFunction(startAwait);
+    LUA->GetField(-3, "coroutine");
+    LUA->GetField(-1, "yield");
+    LUA->Remove(-2); //Coroutine table
+    LUA->Call(2, 2);
+    for (int type: {TYPE_QUERY, TYPE_PREPARED_QUERY, TYPE_TRANSACTION}) {
+        LUA->PushMetaTable(type);
+        LUA->Push(-3); //await
+        LUA->SetField(-2, "await");
+        LUA->Pop(); //Metatable
+    }
+    LUA->PushMetaTable(TYPE_DATABASE);
+    LUA->Push(-2); //queryAsync
+    LUA->SetField(-2, "queryAsync");
+    LUA->Pop(4); //Metatable, queryAsync, await, global
+}
+
+/* Resumes the coroutine that awaits the query with the data of the query (a table with the data of each query
+ * for transactions) or with nil and the error message if the query failed or was aborted.
+ * Returns false if no coroutine awaits the query, in which case the callbacks have to be run instead.
+ */
+bool LuaIQuery::resumeAwaitingCoroutine(ILuaBase *LUA, const std::shared_ptr<IQuery> &iQuery,
+                                        const std::shared_ptr<IQueryData> &data) {
+    if (data->m_coroutineReference == 0) return false;
+    auto query = std::dynamic_pointer_cast<Query>(iQuery);
+    auto transaction = std::dynamic_pointer_cast<Transaction>(iQuery);
+    LUA->PushSpecial(GarrysMod::Lua::SPECIAL_GLOB);
+    LUA->GetField(-1, "coroutine");
+    LUA->GetField(-1, "resume");
+    LUA->ReferencePush(data->m_coroutineReference);
+    if (data->getStatus() == QUERY_ABORTED) {
+        LUA->PushNil();
+        LUA->PushString("Query was aborted");
+    } else if (data->getResultStatus() != QUERY_SUCCESS) {
+        LUA->PushNil();
+        LUA->PushString(data->getError().c_str());
+    } else if (query != nullptr) {
+        LuaQuery::freeDataReference(LUA, *query);
+        LUA->ReferencePush(LuaQuery::createDataReference(LUA, *query, (QueryData &) *data));
+        LUA->PushNil();
+    } else {
+        LuaTransaction::pushResults(LUA, std::dynamic_pointer_cast<TransactionData>(data));
+        LUA->PushNil();
+    }
+    LUA->Call(3, 2);
+    if (!LUA->GetBool(-2)) {
+        //The coroutine errored, coroutine.resume doesn't report that on its own
+        LUA->GetField(-4, "ErrorNoHalt");
+        if (LUA->IsType(-1, GarrysMod::Lua::Type::Function)) {
+            LUA->Push(-2); //Error
+            LUA->Call(1, 0);
+        } else {
+            LUA->Pop(); //Nil
+        }
+    }
+    LUA->Pop(4); //Error or second result, success, coroutine table, global
+    if (query != nullptr) {
+        LuaQuery::freeDataReference(LUA, *query);
+    } else if (transaction != nullptr) {
+        LuaTransaction::freeResults(LUA, std::dynamic_pointer_cast<TransactionData>(data));
+    }
+    return true;
+}
+
 void LuaIQuery::referenceCallbacks(ILuaBase *LUA, int stackPosition, IQueryData &data) {
     LUA->Push(stackPosition);
     data.m_tableReference = LuaReferenceCreate(LUA);
@@ -137,12 +272,21 @@ void LuaIQuery::referenceCallbacks(ILuaBase *LUA, int stackPosition, IQueryData
 void
 LuaIQuery::runCallback(ILuaBase *LUA, const std::shared_ptr<IQuery> &iQuery, const std::shared_ptr<IQueryData> &data) {
     iQuery->setCallbackData(data);
+    if (resumeAwaitingCoroutine(LUA, iQuery, data)) {
+        data->finishLuaQueryData(LUA, iQuery);
+        return;
+    }
+    if (auto query = std::dynamic_pointer_cast<Query>(iQuery)) {
+        //Rows that were streamed while the query was running are always passed on before it finishes
+        LuaQuery::runStreamedDataCallbacks(LUA, query, std::dynamic_pointer_cast<QueryData>(data));
+    }
 
     auto status = data->getResultStatus();
     switch (status) {
         case QUERY_NONE:
             break; //Should not happen
         case QUERY_ERROR:
+        case QUERY_EXPIRED:
             if (auto transaction = std::dynamic_pointer_cast<Transaction>(iQuery)) {
                 LuaTransaction::runErrorCallback(LUA, transaction, std::dynamic_pointer_cast<TransactionData>(data));
             } else {
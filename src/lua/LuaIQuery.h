@@ -24,6 +24,11 @@ public:
 
     static void referenceCallbacks(ILuaBase *LUA, int stackPosition, IQueryData &data);
 
+    static void createAwaitFunctions(ILuaBase *LUA);
+
+    static bool resumeAwaitingCoroutine(ILuaBase *LUA, const std::shared_ptr<IQuery> &query,
+                                        const std::shared_ptr<IQueryData> &data);
+
     static void runAbortedCallback(ILuaBase *LUA, const std::shared_ptr<IQueryData> &data);
 
     static void runErrorCallback(ILuaBase *LUA, const std::shared_ptr<IQuery> &iQuery, const std::shared_ptr<IQueryData> &data);
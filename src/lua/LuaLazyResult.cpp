@@ -0,0 +1,153 @@
+#include "LuaLazyResult.h"
+#include <cmath>
+#include <string_view>
+#include <unordered_map>
+
+int LuaLazyResult::TYPE_LAZY_RESULT = 0;
+int LuaLazyResult::TYPE_LAZY_ROW = 0;
+
+struct LazyResultData {
+    std::shared_ptr<ResultData> result;
+    bool numericFields = false;
+    //Built the first time a cell is indexed by its column name, the keys point into the columns of the result
+    std::unordered_map<std::string_view, unsigned int> columnIndices{};
+};
+
+struct LazyResultRow {
+    std::shared_ptr<LazyResultData> data;
+    size_t row;
+};
+
+void LuaLazyResult::pushValue(ILuaBase *LUA, const ResultData &result, size_t row, unsigned int column) {
+    if (result.isFieldNull(row, column) || result.getColumnTypes()[column] == MYSQL_TYPE_NULL) {
+        LUA->PushNil();
+    } else if (result.isNumericColumn(column)) {
+        LUA->PushNumber(result.getNumber(row, column));
+    } else {
+        std::string_view value = result.getValue(row, column);
+        LUA->PushString(value.data(), (unsigned int) value.length());
+    }
+}
+
+void LuaLazyResult::push(ILuaBase *LUA, std::shared_ptr<ResultData> result, bool numericFields) {
+    auto lazyResult = new LuaLazyResult();
+    lazyResult->m_data = std::make_shared<LazyResultData>();
+    lazyResult->m_data->result = std::move(result);
+    lazyResult->m_data->numericFields = numericFields;
+    LUA->PushUserType(lazyResult, TYPE_LAZY_RESULT);
+}
+
+//Returns the row index of a lua key or SIZE_MAX if it isn't one
+static size_t getRowIndex(ILuaBase *LUA, int stackPosition, size_t rowCount) {
+    if (!LUA->IsType(stackPosition, GarrysMod::Lua::Type::Number)) return SIZE_MAX;
+    double index = LUA->GetNumber(stackPosition);
+    if (index < 1 || index > (double) rowCount || std::floor(index) != index) return SIZE_MAX;
+    return (size_t) index - 1;
+}
+
+LUA_FUNCTION(lazyResultIndex) {
+    auto lazyResult = LUA->GetUserType<LuaLazyResult>(1, LuaLazyResult::TYPE_LAZY_RESULT);
+    if (lazyResult == nullptr) return 0;
+    size_t row = getRowIndex(LUA, 2, lazyResult->m_data->result->getRowCount());
+    if (row == SIZE_MAX) {
+        LUA->PushNil();
+        return 1;
+    }
+    if (lazyResult->m_rowCacheReference == 0) {
+        LUA->CreateTable();
+        lazyResult->m_rowCacheReference = LuaReferenceCreate(LUA);
+    }
+    LUA->ReferencePush(lazyResult->m_rowCacheReference);
+    LUA->Push(2);
+    LUA->RawGet(-2);
+    if (!LUA->IsType(-1, GarrysMod::Lua::Type::Nil)) {
+        return 1;
+    }
+    LUA->Pop(); //Nil
+    LUA->PushUserType(new LazyResultRow{lazyResult->m_data, row}, LuaLazyResult::TYPE_LAZY_ROW);
+    LUA->Push(2);
+    LUA->Push(-2); //Row
+    LUA->RawSet(-4); //Row cache
+    return 1;
+}
+
+LUA_FUNCTION(lazyResultLength) {
+    auto lazyResult = LUA->GetUserType<LuaLazyResult>(1, LuaLazyResult::TYPE_LAZY_RESULT);
+    if (lazyResult == nullptr) return 0;
+    LUA->PushNumber((double) lazyResult->m_data->result->getRowCount());
+    return 1;
+}
+
+LUA_FUNCTION(lazyResultGc) {
+    auto lazyResult = LUA->GetUserType<LuaLazyResult>(1, LuaLazyResult::TYPE_LAZY_RESULT);
+    if (lazyResult == nullptr) return 0;
+    if (lazyResult->m_rowCacheReference != 0) {
+        LuaReferenceFree(LUA, lazyResult->m_rowCacheReference);
+    }
+    delete lazyResult;
+    return 0;
+}
+
+LUA_FUNCTION(lazyRowIndex) {
+    auto lazyRow = LUA->GetUserType<LazyResultRow>(1, LuaLazyResult::TYPE_LAZY_ROW);
+    if (lazyRow == nullptr) return 0;
+    auto &data = *lazyRow->data;
+    const ResultData &result = *data.result;
+    unsigned int column = result.getColumnCount();
+    if (data.numericFields && LUA->IsType(2, GarrysMod::Lua::Type::Number)) {
+        column = (unsigned int) getRowIndex(LUA, 2, result.getColumnCount());
+    } else if (!data.numericFields && LUA->IsType(2, GarrysMod::Lua::Type::String)) {
+        if (data.columnIndices.empty()) {
+            auto &columns = result.getColumns();
+            //Later columns overwrite earlier ones with the same name, just like in a table of the row
+            for (unsigned int i = 0; i < columns.size(); i++) {
+                data.columnIndices[columns[i]] = i;
+            }
+        }
+        unsigned int length = 0;
+        const char *name = LUA->GetString(2, &length);
+        auto it = data.columnIndices.find(std::string_view(name, length));
+        if (it != data.columnIndices.end()) {
+            column = it->second;
+        }
+    }
+    if (column >= result.getColumnCount()) {
+        LUA->PushNil();
+        return 1;
+    }
+    LuaLazyResult::pushValue(LUA, result, lazyRow->row, column);
+    return 1;
+}
+
+LUA_FUNCTION(lazyRowLength) {
+    auto lazyRow = LUA->GetUserType<LazyResultRow>(1, LuaLazyResult::TYPE_LAZY_ROW);
+    if (lazyRow == nullptr) return 0;
+    LUA->PushNumber(lazyRow->data->numericFields ? (double) lazyRow->data->result->getColumnCount() : 0);
+    return 1;
+}
+
+LUA_FUNCTION(lazyRowGc) {
+    auto lazyRow = LUA->GetUserType<LazyResultRow>(1, LuaLazyResult::TYPE_LAZY_ROW);
+    delete lazyRow;
+    return 0;
+}
+
+void LuaLazyResult::createMetaTables(ILuaBase *LUA) {
+    TYPE_LAZY_RESULT = LUA->CreateMetaTable("MySQLOO Lazy Result");
+    LUA->PushCFunction(lazyResultIndex);
+    LUA->SetField(-2, "__index");
+    LUA->PushCFunction(lazyResultLength);
+    LUA->SetField(-2, "__len");
+    LUA->PushCFunction(lazyResultGc);
+    LUA->SetField(-2, "__gc");
+    LUA->Pop(); //Metatable
+
+    TYPE_LAZY_ROW = LUA->CreateMetaTable("MySQLOO Lazy Row");
+    LUA->PushCFunction(lazyRowIndex);
+    LUA->SetField(-2, "__index");
+    LUA->PushCFunction(lazyRowLength);
+    LUA->SetField(-2, "__len");
+    LUA->PushCFunction(lazyRowGc);
+    LUA->SetField(-2, "__gc");
+    LUA->Pop(); //Metatable
+}
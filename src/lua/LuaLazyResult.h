@@ -0,0 +1,30 @@
+#ifndef MYSQLOO_LUALAZYRESULT_H
+#define MYSQLOO_LUALAZYRESULT_H
+
+#include <memory>
+#include "LuaObject.h"
+#include "../mysql/ResultData.h"
+
+struct LazyResultData;
+
+/* Result set that is passed to lua as userdata instead of a table of rows (see OPTION_LAZY_ROWS).
+ * result[i] creates the row the first time it is accessed, rows are userdata as well and
+ * only push the value of a cell to lua when the cell is indexed.
+ * The rows share the ResultData, so they stay valid after the query and its result are gone.
+ */
+class LuaLazyResult {
+public:
+    static void createMetaTables(ILuaBase *LUA);
+
+    static void push(ILuaBase *LUA, std::shared_ptr<ResultData> result, bool numericFields);
+
+    static void pushValue(ILuaBase *LUA, const ResultData &result, size_t row, unsigned int column);
+
+    static int TYPE_LAZY_RESULT;
+    static int TYPE_LAZY_ROW;
+
+    std::shared_ptr<LazyResultData> m_data;
+    int m_rowCacheReference = 0; //Table of the rows that were already accessed
+};
+
+#endif //MYSQLOO_LUALAZYRESULT_H
@@ -22,7 +22,7 @@ MYSQLOO_LUA_FUNCTION(setString) {
     unsigned int length = 0;
     const char *string = LUA->GetString(3, &length);
     auto uIndex = (unsigned int) index;
-    query->setString(uIndex, std::string(string, length));
+    query->setString(uIndex, string, length);
     return 0;
 }
 
@@ -48,6 +48,78 @@ MYSQLOO_LUA_FUNCTION(setNull) {
     return 0;
 }
 
+/* Sets the current parameter set from the table at the given stack position, the keys are the parameter indices.
+ * The types are inferred from the lua values, values of other types are converted to strings using tostring.
+ */
+static void setParametersFromTable(ILuaBase *LUA, PreparedQuery *query, int tableIndex) {
+    LUA->PushNil();
+    while (LUA->Next(tableIndex)) {
+        if (LUA->GetType(-2) != GarrysMod::Lua::Type::Number) {
+            LUA->ThrowError("Parameter indices must be numbers");
+        }
+        auto uIndex = (unsigned int) LUA->GetNumber(-2);
+        switch (LUA->GetType(-1)) {
+            case GarrysMod::Lua::Type::Number:
+                query->setNumber(uIndex, LUA->GetNumber(-1));
+                break;
+            case GarrysMod::Lua::Type::Bool:
+                query->setBoolean(uIndex, LUA->GetBool(-1));
+                break;
+            case GarrysMod::Lua::Type::String: {
+                unsigned int length = 0;
+                const char *string = LUA->GetString(-1, &length);
+                query->setString(uIndex, string, length);
+                break;
+            }
+            default: {
+                LUA->PushSpecial(GarrysMod::Lua::SPECIAL_GLOB);
+                LUA->GetField(-1, "tostring");
+                LUA->Push(-3); //Value
+                LUA->Call(1, 1);
+                unsigned int length = 0;
+                const char *string = LUA->GetString(-1, &length);
+                query->setString(uIndex, string, length);
+                LUA->Pop(2); //String, global table
+                break;
+            }
+        }
+        LUA->Pop(); //Value, the key is needed by Next
+    }
+}
+
+//Replaces the parameters of the current parameter set with the values of a table in a single call
+MYSQLOO_LUA_FUNCTION(setParameters) {
+    auto luaQuery = LuaObject::getLuaObject<LuaPreparedQuery>(LUA);
+    auto query = (PreparedQuery *) luaQuery->m_query.get();
+    LUA->CheckType(2, GarrysMod::Lua::Type::Table);
+    query->clearCurrentParameters();
+    setParametersFromTable(LUA, query, 2);
+    return 0;
+}
+
+/* Adds each table of an array of tables as its own parameter set, as if putNewParameters was called between them.
+ * The first row fills the current parameter set if no parameters have been set in it yet.
+ */
+MYSQLOO_LUA_FUNCTION(addParameterRows) {
+    auto luaQuery = LuaObject::getLuaObject<LuaPreparedQuery>(LUA);
+    auto query = (PreparedQuery *) luaQuery->m_query.get();
+    LUA->CheckType(2, GarrysMod::Lua::Type::Table);
+    int rowCount = LUA->ObjLen(2);
+    for (int i = 1; i <= rowCount; i++) {
+        LUA->PushNumber(i);
+        LUA->GetTable(2);
+        if (!LUA->IsType(-1, GarrysMod::Lua::Type::Table)) {
+            LUA->ThrowError("Parameter rows must be tables");
+        }
+        if (i > 1 || query->hasCurrentParameters()) {
+            query->putNewParameters();
+        }
+        setParametersFromTable(LUA, query, LUA->Top());
+        LUA->Pop(); //Row
+    }
+    return 0;
+}
+
 MYSQLOO_LUA_FUNCTION(putNewParameters) {
     auto luaQuery = LuaObject::getLuaObject<LuaPreparedQuery>(LUA);
     auto query = (PreparedQuery *) luaQuery->m_query.get();
@@ -74,6 +146,10 @@ void LuaPreparedQuery::createMetaTable(ILuaBase *LUA) {
     LUA->SetField(-2, "setBoolean");
     LUA->PushCFunction(setNull);
     LUA->SetField(-2, "setNull");
+    LUA->PushCFunction(setParameters);
+    LUA->SetField(-2, "setParameters");
+    LUA->PushCFunction(addParameterRows);
+    LUA->SetField(-2, "addParameterRows");
     LUA->PushCFunction(putNewParameters);
     LUA->SetField(-2, "putNewParameters");
     LUA->PushCFunction(clearParameters);
@@ -87,6 +163,7 @@ std::shared_ptr<IQueryData> LuaPreparedQuery::buildQueryData(ILuaBase* LUA, int
     auto data = query->buildQueryData();
     if (shouldRef) {
         LuaIQuery::referenceCallbacks(LUA, stackPosition, *data);
+        data->setStreamResults(query->hasOption(OPTION_STREAM_RESULTS));
     }
     return data;
 }
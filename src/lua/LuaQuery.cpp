@@ -1,85 +1,106 @@
 
 #include "LuaQuery.h"
+#include "LuaLazyResult.h"
+#include "LuaRawResult.h"
 
-//Function that converts the data stored in a mysql field into a lua type
+//Function that pushes the data stored in a mysql field to lua
+//Numeric fields have already been converted to numbers by the database thread
 //Expects the row table to be at the top of the stack at the start of this function
-//Adds a column to the row table
-static void dataToLua(Query &query,
-                      GarrysMod::Lua::ILuaBase *LUA, unsigned int column,
-                      std::string &columnValue, const char *columnName, int columnType, bool isNull) {
-    if (query.hasOption(OPTION_NUMERIC_FIELDS)) {
-        LUA->PushNumber(column);
+//Adds a column to the row table, the key of named columns is taken from the table of column names
+static void dataToLua(GarrysMod::Lua::ILuaBase *LUA, const ResultData &resultData, size_t row, unsigned int column,
+                      int columnNamesStackPosition) {
+    LUA->PushNumber(column + 1);
+    if (columnNamesStackPosition != 0) {
+        LUA->RawGet(columnNamesStackPosition);
     }
-    if (isNull) {
-        LUA->PushNil();
-    } else {
-        switch (columnType) {
-            case MYSQL_TYPE_FLOAT:
-            case MYSQL_TYPE_DOUBLE:
-            case MYSQL_TYPE_LONGLONG:
-            case MYSQL_TYPE_LONG:
-            case MYSQL_TYPE_INT24:
-            case MYSQL_TYPE_TINY:
-            case MYSQL_TYPE_SHORT:
-                LUA->PushNumber(atof(columnValue.c_str()));
-                break;
-            case MYSQL_TYPE_BIT: {
-                // BIT fields are returned as binary data
-                // Convert bytes to unsigned integer (big-endian)
-                unsigned long long bitValue = 0;
-                for (size_t i = 0; i < columnValue.length() && i < 8; i++) {
-                    bitValue = bitValue << 8 | static_cast<unsigned char>(columnValue[i]);
-                }
-                LUA->PushNumber(static_cast<double>(bitValue));
-                break;
-            }
-            case MYSQL_TYPE_NULL:
-                LUA->PushNil();
-                break;
-            default:
-                LUA->PushString(columnValue.c_str(), (unsigned int) columnValue.length());
-                break;
+    LuaLazyResult::pushValue(LUA, resultData, row, column);
+    LUA->RawSet(-3);
+}
+
+/* Pushes a table containing all rows of a result set.
+ * The column names are converted to lua strings once per result set and reused as the keys of every row,
+ * instead of hashing and interning the C string of the name again for every cell.
+ */
+static void pushResultData(ILuaBase *LUA, Query &query, const ResultData &resultData) {
+    LUA->CreateTable();
+    int dataStackPosition = LUA->Top();
+    const unsigned int columnCount = resultData.getColumnCount();
+    int columnNamesStackPosition = 0;
+    if (!query.hasOption(OPTION_NUMERIC_FIELDS) && resultData.getRowCount() > 0) {
+        LUA->CreateTable();
+        columnNamesStackPosition = LUA->Top();
+        auto &columns = resultData.getColumns();
+        for (unsigned int j = 0; j < columnCount; j++) {
+            LUA->PushNumber(j + 1);
+            LUA->PushString(columns[j].c_str(), (unsigned int) columns[j].length());
+            LUA->RawSet(columnNamesStackPosition);
         }
     }
-    if (query.hasOption(OPTION_NUMERIC_FIELDS)) {
-        LUA->SetTable(-3);
-    } else {
-        LUA->SetField(-2, columnName);
+    for (size_t i = 0; i < resultData.getRowCount(); i++) {
+        LUA->PushNumber((double) (i + 1));
+        LUA->CreateTable();
+        for (unsigned int j = 0; j < columnCount; j++) {
+            dataToLua(LUA, resultData, i, j, columnNamesStackPosition);
+        }
+        LUA->RawSet(dataStackPosition);
+    }
+    if (columnNamesStackPosition != 0) {
+        LUA->Pop(); //Column names
     }
 }
 
+/* Pushes a table containing one array of values per column, keyed by the column name or its index (see OPTION_COLUMNAR).
+ * NULL values leave holes in the arrays of their columns.
+ */
+static void pushColumnarData(ILuaBase *LUA, Query &query, const ResultData &resultData) {
+    LUA->CreateTable();
+    int dataStackPosition = LUA->Top();
+    const bool numericFields = query.hasOption(OPTION_NUMERIC_FIELDS);
+    auto &columns = resultData.getColumns();
+    for (unsigned int j = 0; j < resultData.getColumnCount(); j++) {
+        if (numericFields) {
+            LUA->PushNumber(j + 1);
+        } else {
+            LUA->PushString(columns[j].c_str(), (unsigned int) columns[j].length());
+        }
+        LUA->CreateTable();
+        for (size_t i = 0; i < resultData.getRowCount(); i++) {
+            LUA->PushNumber((double) (i + 1));
+            LuaLazyResult::pushValue(LUA, resultData, i, j);
+            LUA->RawSet(-3);
+        }
+        LUA->RawSet(dataStackPosition);
+    }
+}
+
+//Lazy rows take precedence over the columnar format
+static bool isColumnar(const Query &query) {
+    return query.hasOption(OPTION_COLUMNAR) && !query.hasOption(OPTION_LAZY_ROWS);
+}
+
 //Stores the data associated with the current result set of the query
 //Only called once per result set (and then cached)
 int LuaQuery::createDataReference(GarrysMod::Lua::ILuaBase *LUA, Query &query, QueryData &data) {
     if (query.m_dataReference != 0)
         return query.m_dataReference;
-    LUA->CreateTable();
-    int dataStackPosition = LUA->Top();
-    if (query.hasCallbackData() && data.hasMoreResults()) {
-        ResultData &currentData = data.getResult();
-        for (unsigned int i = 0; i < currentData.getRows().size(); i++) {
-            ResultDataRow &row = currentData.getRows()[i];
-            LUA->CreateTable();
-            int rowStackPosition = LUA->Top();
-            for (unsigned int j = 0; j < row.getValues().size(); j++) {
-                dataToLua(query, LUA, j + 1, row.getValues()[j], currentData.getColumns()[j].c_str(),
-                          currentData.getColumnTypes()[j], row.isFieldNull(j));
-            }
-            LUA->Push(dataStackPosition);
-            LUA->PushNumber(i + 1);
-            LUA->Push(rowStackPosition);
-            LUA->SetTable(-3);
-            LUA->Pop(2); //data + row
-        }
+    if (query.hasCallbackData() && data.hasMoreResults() && query.hasOption(OPTION_LAZY_ROWS)) {
+        LuaLazyResult::push(LUA, data.getSharedResult(), query.hasOption(OPTION_NUMERIC_FIELDS));
+    } else if (query.hasCallbackData() && data.hasMoreResults() && isColumnar(query)) {
+        pushColumnarData(LUA, query, data.getResult());
+    } else if (query.hasCallbackData() && data.hasMoreResults()) {
+        pushResultData(LUA, query, data.getResult());
+    } else {
+        LUA->CreateTable();
     }
     query.m_dataReference = LuaReferenceCreate(LUA);
     return query.m_dataReference;
 }
 
+//onData always receives rows, if the data reference is 0 the rows are only built for the callback (columnar results)
 static void runOnDataCallbacks(
         ILuaBase *LUA,
         const std::shared_ptr<Query> &query,
-        const std::shared_ptr<IQueryData> &data,
+        const std::shared_ptr<QueryData> &data,
         int dataReference
 ) {
     if (!LuaIQuery::pushCallbackReference(LUA, data->m_onDataReference, data->m_tableReference,
@@ -88,10 +109,16 @@ static void runOnDataCallbacks(
     }
     int callbackPosition = LUA->Top();
     int index = 1;
-    LUA->ReferencePush(dataReference);
+    if (dataReference != 0) {
+        LUA->ReferencePush(dataReference);
+    } else if (data->hasMoreResults()) {
+        pushResultData(LUA, *query, data->getResult());
+    } else {
+        LUA->CreateTable();
+    }
     while (true) {
         LUA->PushNumber(index++);
-        LUA->RawGet(-2);
+        LUA->GetTable(-2); //Not raw, the data might be a lazy result
         if (LUA->GetType(-1) == GarrysMod::Lua::Type::Nil) {
             LUA->Pop(); //Nil
             break;
@@ -109,11 +136,25 @@ static void runOnDataCallbacks(
 }
 
 
+//Passes the rows that a streaming query has fetched so far to its onData callback
+void LuaQuery::runStreamedDataCallbacks(ILuaBase *LUA, const std::shared_ptr<Query> &query,
+                                        const std::shared_ptr<QueryData> &data) {
+    std::deque<ResultData> streamedResults;
+    query->takeStreamedResults(*data, streamedResults);
+    if (data->m_tableReference == 0) return;
+    for (auto &resultData: streamedResults) {
+        pushResultData(LUA, *query, resultData);
+        int dataReference = LuaReferenceCreate(LUA);
+        runOnDataCallbacks(LUA, query, data, dataReference);
+        LuaReferenceFree(LUA, dataReference);
+    }
+}
+
 void LuaQuery::runSuccessCallback(ILuaBase *LUA, const std::shared_ptr<Query>& query, const std::shared_ptr<QueryData> &data) {
     //Need to clear old data, if it exists
     freeDataReference(LUA, *query);
     int dataReference = LuaQuery::createDataReference(LUA, *query, *data);
-    runOnDataCallbacks(LUA, query, data, dataReference);
+    runOnDataCallbacks(LUA, query, data, isColumnar(*query) ? 0 : dataReference);
 
     if (!LuaIQuery::pushCallbackReference(LUA, data->m_successReference, data->m_tableReference,
                                           "onSuccess", data->isFirstData())) {
@@ -142,7 +183,7 @@ MYSQLOO_LUA_FUNCTION(lastInsert) {
 MYSQLOO_LUA_FUNCTION(getData) {
     auto luaQuery = LuaQuery::getLuaObject<LuaQuery>(LUA);
     auto query = std::dynamic_pointer_cast<Query>(luaQuery->m_query);
-    if (!query->hasCallbackData() || query->callbackQueryData->getResultStatus() == QUERY_ERROR) {
+    if (!query->hasCallbackData() || query->callbackQueryData->getResultStatus() != QUERY_SUCCESS) {
         LUA->PushNil();
     } else {
         int ref = LuaQuery::createDataReference(LUA, *query, (QueryData &) *(query->callbackQueryData));
@@ -151,6 +192,19 @@ MYSQLOO_LUA_FUNCTION(getData) {
     return 1;
 }
 
+//Pins the current result set, so it can be read through the ffi without converting it to lua tables
+MYSQLOO_LUA_FUNCTION(getRawResult) {
+    auto luaQuery = LuaQuery::getLuaObject<LuaQuery>(LUA);
+    auto query = std::dynamic_pointer_cast<Query>(luaQuery->m_query);
+    if (!query->hasCallbackData() || query->callbackQueryData->getResultStatus() != QUERY_SUCCESS) {
+        LUA->PushNil();
+        return 1;
+    }
+    auto &data = (QueryData &) *(query->callbackQueryData);
+    LuaRawResult::push(LUA, data.hasMoreResults() ? data.getSharedResult() : ResultData::empty());
+    return 1;
+}
+
 MYSQLOO_LUA_FUNCTION(hasMoreResults) {
     auto luaQuery = LuaQuery::getLuaObject<LuaQuery>(LUA);
     auto query = (Query *) luaQuery->m_query.get();
@@ -175,6 +229,8 @@ void LuaQuery::addMetaTableFunctions(ILuaBase *LUA) {
     LUA->SetField(-2, "lastInsert");
     LUA->PushCFunction(getData);
     LUA->SetField(-2, "getData");
+    LUA->PushCFunction(getRawResult);
+    LUA->SetField(-2, "getRawResult");
     LUA->PushCFunction(hasMoreResults);
     LUA->SetField(-2, "hasMoreResults");
     LUA->PushCFunction(getNextResults);
@@ -193,6 +249,7 @@ std::shared_ptr<IQueryData> LuaQuery::buildQueryData(ILuaBase *LUA, int stackPos
     data->setStatus(QUERY_COMPLETE);
     if (shouldRef) {
         LuaIQuery::referenceCallbacks(LUA, stackPosition, *data);
+        data->setStreamResults(query->hasOption(OPTION_STREAM_RESULTS));
     }
     return data;
 }
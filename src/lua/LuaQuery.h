@@ -15,6 +15,9 @@ public:
 
     static void createMetaTable(ILuaBase *LUA);
 
+    static void runStreamedDataCallbacks(ILuaBase *LUA, const std::shared_ptr<Query> &query,
+                                         const std::shared_ptr<QueryData> &data);
+
     static void runSuccessCallback(ILuaBase *LUA, const std::shared_ptr<Query>& query, const std::shared_ptr<QueryData> &data);
 
     std::shared_ptr<IQueryData> buildQueryData(ILuaBase *LUA, int stackPosition, bool shouldRef) override;
@@ -0,0 +1,48 @@
+#include "LuaRawResult.h"
+#include <cstdint>
+
+int LuaRawResult::TYPE_RAW_RESULT = 0;
+
+void LuaRawResult::push(ILuaBase *LUA, std::shared_ptr<ResultData> result) {
+    auto rawResult = new LuaRawResult();
+    rawResult->m_result = std::move(result);
+    rawResult->m_raw = rawResult->m_result->getRawResult(rawResult->m_columns);
+    LUA->PushUserType(rawResult, TYPE_RAW_RESULT);
+}
+
+LUA_FUNCTION(rawResultAddress) {
+    auto rawResult = LUA->GetUserType<LuaRawResult>(1, LuaRawResult::TYPE_RAW_RESULT);
+    if (rawResult == nullptr) {
+        LUA->ThrowError("Expected a raw result");
+        return 0;
+    }
+    //ILuaBase can't push light userdata, user space addresses fit into a double without losing precision
+    LUA->PushNumber((double) reinterpret_cast<uintptr_t>(&rawResult->m_raw));
+    return 1;
+}
+
+LUA_FUNCTION(rawResultLength) {
+    auto rawResult = LUA->GetUserType<LuaRawResult>(1, LuaRawResult::TYPE_RAW_RESULT);
+    if (rawResult == nullptr) return 0;
+    LUA->PushNumber((double) rawResult->m_raw.rowCount);
+    return 1;
+}
+
+LUA_FUNCTION(rawResultGc) {
+    auto rawResult = LUA->GetUserType<LuaRawResult>(1, LuaRawResult::TYPE_RAW_RESULT);
+    delete rawResult;
+    return 0;
+}
+
+void LuaRawResult::createMetaTable(ILuaBase *LUA) {
+    TYPE_RAW_RESULT = LUA->CreateMetaTable("MySQLOO Raw Result");
+    LUA->Push(-1);
+    LUA->SetField(-2, "__index");
+    LUA->PushCFunction(rawResultAddress);
+    LUA->SetField(-2, "address");
+    LUA->PushCFunction(rawResultLength);
+    LUA->SetField(-2, "__len");
+    LUA->PushCFunction(rawResultGc);
+    LUA->SetField(-2, "__gc");
+    LUA->Pop(); //Metatable
+}
@@ -0,0 +1,27 @@
+#ifndef MYSQLOO_LUARAWRESULT_H
+#define MYSQLOO_LUARAWRESULT_H
+
+#include <memory>
+#include <vector>
+#include "LuaObject.h"
+#include "../mysql/ResultData.h"
+
+/* Handle returned by query:getRawResult() that pins the storage of a result set.
+ * handle:address() returns the address of a RawResult as a number, which the LuaJIT ffi can cast and read
+ * without creating any lua tables (see lua/mysqlooffi.lua).
+ * All pointers stay valid until the handle is garbage collected.
+ */
+class LuaRawResult {
+public:
+    static void createMetaTable(ILuaBase *LUA);
+
+    static void push(ILuaBase *LUA, std::shared_ptr<ResultData> result);
+
+    static int TYPE_RAW_RESULT;
+
+    std::shared_ptr<ResultData> m_result;
+    std::vector<RawResultColumn> m_columns{};
+    RawResult m_raw{};
+};
+
+#endif //MYSQLOO_LUARAWRESULT_H
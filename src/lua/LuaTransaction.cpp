@@ -84,7 +84,7 @@ std::shared_ptr<IQueryData> LuaTransaction::buildQueryData(ILuaBase *LUA, int st
     }
     LUA->Pop(); //Queries table
 
-    auto data = Transaction::buildQueryData(queries);
+    auto data = Transaction::buildQueryData(std::move(queries));
     if (shouldRef) {
         LuaIQuery::referenceCallbacks(LUA, stackPosition, *data);
     }
@@ -117,15 +117,13 @@ void LuaTransaction::runErrorCallback(GarrysMod::Lua::ILuaBase *LUA, const std::
     LuaIQuery::runErrorCallback(LUA, transaction, data);
 }
 
-void LuaTransaction::runSuccessCallback(ILuaBase *LUA, const std::shared_ptr<Transaction> &transaction,
-                                        const std::shared_ptr<TransactionData> &data) {
-    auto transactionData = std::dynamic_pointer_cast<TransactionData>(data);
-    if (transactionData->m_tableReference == 0) return;
-    transactionData->setStatus(QUERY_COMPLETE);
+//Pushes a table containing the data of each query of the transaction
+void LuaTransaction::pushResults(ILuaBase *LUA, const std::shared_ptr<TransactionData> &data) {
+    data->setStatus(QUERY_COMPLETE);
     LUA->CreateTable();
     int index = 0;
     // Set the correct callback data for the queries of the transaction
-    for (auto &pair: transactionData->m_queries) {
+    for (auto &pair: data->m_queries) {
         LUA->PushNumber((double) (++index));
         auto query = pair.first;
         //So we get the current data rather than caching it, if the same query is added multiple times.
@@ -137,6 +135,20 @@ void LuaTransaction::runSuccessCallback(ILuaBase *LUA, const std::shared_ptr<Tra
         LUA->SetTable(-3);
         //The last data reference can stay cached in the query and will be freed once the query is gc'ed
     }
+}
+
+//We should only cache the data for the duration of the callback
+void LuaTransaction::freeResults(ILuaBase *LUA, const std::shared_ptr<TransactionData> &data) {
+    for (auto &pair: data->m_queries) {
+        LuaQuery::freeDataReference(LUA, *pair.first);
+    }
+}
+
+void LuaTransaction::runSuccessCallback(ILuaBase *LUA, const std::shared_ptr<Transaction> &transaction,
+                                        const std::shared_ptr<TransactionData> &data) {
+    auto transactionData = std::dynamic_pointer_cast<TransactionData>(data);
+    if (transactionData->m_tableReference == 0) return;
+    pushResults(LUA, transactionData);
     if (!LuaIQuery::pushCallbackReference(LUA, data->m_successReference, data->m_tableReference,
                                           "onSuccess", data->isFirstData())) {
         LUA->Pop(); //Table of results
@@ -148,8 +160,5 @@ void LuaTransaction::runSuccessCallback(ILuaBase *LUA, const std::shared_ptr<Tra
 
     LUA->Pop(); //Table of results
 
-    for (auto &pair: transactionData->m_queries) {
-        //We should only cache the data for the duration of the callback
-        LuaQuery::freeDataReference(LUA, *pair.first);
-    }
+    freeResults(LUA, transactionData);
 }
\ No newline at end of file
@@ -18,6 +18,10 @@ public:
     ) {
     }
 
+    static void pushResults(ILuaBase *LUA, const std::shared_ptr<TransactionData> &data);
+
+    static void freeResults(ILuaBase *LUA, const std::shared_ptr<TransactionData> &data);
+
     static void runSuccessCallback(ILuaBase *LUA, const std::shared_ptr<Transaction> &transaction,
                                    const std::shared_ptr<TransactionData> &data);
 
@@ -0,0 +1,165 @@
+#include "ConnectionPoller.h"
+#include "ConnectionScheduler.h"
+#include "DatabaseConnection.h"
+#include <vector>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+ConnectionPoller &ConnectionPoller::getInstance() {
+    static ConnectionPoller instance;
+    return instance;
+}
+
+bool ConnectionPoller::isSupported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+ConnectionPoller::~ConnectionPoller() {
+    shutdown();
+}
+
+/* Schedules the connection again once its socket is readable.
+ * Returns false if the connection can't be watched, the caller then has to wait for the socket itself.
+ */
+bool ConnectionPoller::watch(DatabaseConnection &connection) {
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(m_pollMutex);
+    if (stopped || (epollFd == -1 && !start())) {
+        return false;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = &connection;
+    watchedConnections.insert(&connection);
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, mysql_get_socket(connection.m_sql), &event) != 0) {
+        watchedConnections.erase(&connection);
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+/* Stops the thread and schedules all connections that are still waiting for the server,
+ * they finish their queries with blocking waits. Called when the module is unloaded.
+ */
+void ConnectionPoller::shutdown() {
+#ifdef __linux__
+    std::unordered_set<DatabaseConnection *> remainingConnections;
+    {
+        std::lock_guard<std::mutex> lock(m_pollMutex);
+        if (stopped) return;
+        stopped = true;
+        if (epollFd == -1) return;
+        uint64_t value = 1;
+        //If this fails the thread is woken up by the next connection that becomes readable
+        (void) !write(wakeupFd, &value, sizeof(value));
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_pollMutex);
+        remainingConnections.swap(watchedConnections);
+        close(epollFd);
+        close(wakeupFd);
+        epollFd = -1;
+        wakeupFd = -1;
+    }
+    for (auto connection: remainingConnections) {
+        ConnectionScheduler::getInstance().schedule(*connection);
+    }
+#endif
+}
+
+//Blocks until the socket of the connection is readable, used if the connection can't be watched
+void ConnectionPoller::waitForSocket(MYSQL *sql) {
+#ifdef __linux__
+    pollfd fd{};
+    fd.fd = mysql_get_socket(sql);
+    fd.events = POLLIN;
+    poll(&fd, 1, -1);
+#endif
+}
+
+//Checks without blocking whether the server has already responded, the connection then doesn't need to be watched
+bool ConnectionPoller::isReadable(MYSQL *sql) {
+#ifdef __linux__
+    pollfd fd{};
+    fd.fd = mysql_get_socket(sql);
+    fd.events = POLLIN;
+    return poll(&fd, 1, 0) > 0;
+#else
+    return true;
+#endif
+}
+
+//Needs to be called with m_pollMutex locked
+bool ConnectionPoller::start() {
+#ifdef __linux__
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        return false;
+    }
+    wakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (wakeupFd == -1 || epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeupFd, &event) != 0) {
+        close(epollFd);
+        if (wakeupFd != -1) close(wakeupFd);
+        epollFd = -1;
+        wakeupFd = -1;
+        return false;
+    }
+    thread = std::thread(&ConnectionPoller::run, this);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ConnectionPoller::run() {
+#ifdef __linux__
+    std::vector<epoll_event> events(64);
+    std::vector<DatabaseConnection *> readyConnections;
+    bool shouldStop = false;
+    while (!shouldStop) {
+        int eventCount = epoll_wait(epollFd, events.data(), (int) events.size(), -1);
+        if (eventCount < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_pollMutex);
+            for (int i = 0; i < eventCount; i++) {
+                auto *connection = static_cast<DatabaseConnection *>(events[i].data.ptr);
+                if (connection == nullptr) {
+                    //Woken up by shutdown, the remaining connections are scheduled by shutdown
+                    shouldStop = true;
+                    continue;
+                }
+                if (watchedConnections.erase(connection) == 0) continue;
+                //The socket might be different for the next query in case the connection reconnects
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, mysql_get_socket(connection->m_sql), nullptr);
+                readyConnections.push_back(connection);
+            }
+        }
+        //Scheduled outside the lock, since a scheduler thread might immediately watch the connection again
+        for (auto connection: readyConnections) {
+            ConnectionScheduler::getInstance().schedule(*connection);
+        }
+        readyConnections.clear();
+    }
+#endif
+}
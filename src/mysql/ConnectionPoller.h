@@ -0,0 +1,51 @@
+#ifndef CONNECTIONPOLLER_
+#define CONNECTIONPOLLER_
+
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include "MySQLHeader.h"
+
+class DatabaseConnection;
+
+/* Single thread that waits for the sockets of connections that are running a non blocking query.
+ * Instead of blocking a thread of the ConnectionScheduler while the server processes a query, the connection
+ * is handed to this thread and scheduled again once its socket becomes readable.
+ * This is only available on linux (epoll), other platforms always run queries with the blocking api.
+ */
+class ConnectionPoller {
+public:
+    static ConnectionPoller &getInstance();
+
+    static bool isSupported();
+
+    ConnectionPoller(const ConnectionPoller &) = delete;
+
+    ConnectionPoller &operator=(const ConnectionPoller &) = delete;
+
+    ~ConnectionPoller();
+
+    bool watch(DatabaseConnection &connection);
+
+    void shutdown();
+
+    static void waitForSocket(MYSQL *sql);
+
+    static bool isReadable(MYSQL *sql);
+
+private:
+    ConnectionPoller() = default;
+
+    bool start();
+
+    void run();
+
+    std::mutex m_pollMutex; //Protects everything below
+    std::thread thread{};
+    std::unordered_set<DatabaseConnection *> watchedConnections{};
+    int epollFd = -1;
+    int wakeupFd = -1;
+    bool stopped = false;
+};
+
+#endif
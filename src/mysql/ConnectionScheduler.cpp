@@ -0,0 +1,145 @@
+#include "ConnectionScheduler.h"
+#include "Database.h"
+#include <algorithm>
+#include <deque>
+#include <iterator>
+
+ConnectionScheduler &ConnectionScheduler::getInstance() {
+    static ConnectionScheduler instance;
+    return instance;
+}
+
+ConnectionScheduler::~ConnectionScheduler() {
+    shutdown();
+}
+
+//True on the threads of the pool that must not wait for the server
+static thread_local bool isNonBlockingThread = false;
+//Connections that are run on the current thread after the scheduler was stopped, null if there is no such loop yet
+static thread_local std::deque<DatabaseConnection *> *inlineConnections = nullptr;
+
+unsigned int ConnectionScheduler::coreCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/* Queues a connection that has queued queries to be run by one of the threads.
+ * The caller has to make sure that a connection is never queued twice at once (see DatabaseConnection::m_scheduled).
+ */
+void ConnectionScheduler::schedule(DatabaseConnection &connection) {
+    {
+        std::lock_guard<std::mutex> lock(m_threadMutex);
+        if (!stopped) {
+            //Threads are only started once they are needed. They are kept after their connection was closed,
+            //so they can be used by connections of databases that are created later on.
+            while (threads.size() < std::min(coreCount(), std::max(1u, connectionCount))) {
+                threads.emplace_back(&ConnectionScheduler::run, this, std::ref(readyConnections), false);
+            }
+            readyConnections.put(&connection);
+            return;
+        }
+    }
+    runInline(connection);
+}
+
+/* Queues a connection whose next query blocks its thread until the server has responded.
+ * The query has to be the pending query of the connection, it is run before any other query of the connection.
+ */
+void ConnectionScheduler::scheduleBlocking(DatabaseConnection &connection) {
+    {
+        std::lock_guard<std::mutex> lock(m_threadMutex);
+        if (!stopped) {
+            const unsigned int maxThreads = coreCount() * BLOCKING_THREADS_PER_CORE;
+            while (blockingThreads.size() < std::min(maxThreads, std::max(1u, connectionCount))) {
+                blockingThreads.emplace_back(&ConnectionScheduler::run, this, std::ref(blockingConnections), true);
+            }
+            blockingConnections.put(&connection);
+            return;
+        }
+    }
+    runInline(connection);
+}
+
+//Whether the current thread may wait for the server
+bool ConnectionScheduler::canRunBlocking() {
+    return !isNonBlockingThread;
+}
+
+/* The module is being unloaded and the threads are gone, the queries are run on the current thread instead
+ * so disconnecting databases can not hang.
+ * Connections that are scheduled again while doing so are run by the outermost call, so the stack doesn't grow.
+ */
+void ConnectionScheduler::runInline(DatabaseConnection &connection) {
+    if (inlineConnections != nullptr) {
+        inlineConnections->push_back(&connection);
+        return;
+    }
+    std::deque<DatabaseConnection *> connections{&connection};
+    inlineConnections = &connections;
+    auto loopEnd = finally([&] { inlineConnections = nullptr; });
+    while (!connections.empty()) {
+        DatabaseConnection *next = connections.front();
+        connections.pop_front();
+        next->getDatabase().run(*next);
+    }
+}
+
+//Called when a database starts connecting, the pool grows once the connections are scheduled
+void ConnectionScheduler::addConnections(unsigned int count) {
+    std::lock_guard<std::mutex> lock(m_threadMutex);
+    connectionCount += count;
+}
+
+//Called once a connection has been closed
+void ConnectionScheduler::removeConnection() {
+    std::lock_guard<std::mutex> lock(m_threadMutex);
+    connectionCount--;
+}
+
+/* Stops all threads after they have run all connections that are currently scheduled.
+ * Called when the module is unloaded.
+ */
+void ConnectionScheduler::shutdown() {
+    std::vector<std::thread> stoppedThreads;
+    std::vector<std::thread> stoppedBlockingThreads;
+    {
+        std::lock_guard<std::mutex> lock(m_threadMutex);
+        if (stopped) return;
+        stopped = true;
+        stoppedThreads.swap(threads);
+        stoppedBlockingThreads.swap(blockingThreads);
+    }
+    //Poison pills, each thread consumes exactly one of them
+    for (size_t i = 0; i < stoppedThreads.size(); i++) {
+        readyConnections.put(nullptr);
+    }
+    for (size_t i = 0; i < stoppedBlockingThreads.size(); i++) {
+        blockingConnections.put(nullptr);
+    }
+    stoppedThreads.insert(stoppedThreads.end(), std::make_move_iterator(stoppedBlockingThreads.begin()),
+                          std::make_move_iterator(stoppedBlockingThreads.end()));
+    for (auto &thread: stoppedThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+bool ConnectionScheduler::isStopped() {
+    std::lock_guard<std::mutex> lock(m_threadMutex);
+    return stopped;
+}
+
+void ConnectionScheduler::run(BlockingQueue<DatabaseConnection *> &queue, bool blocking) {
+    mysql_thread_init();
+    auto threadEnd = finally([&] {
+        mysql_thread_end();
+    });
+    isNonBlockingThread = !blocking;
+    while (true) {
+        DatabaseConnection *connection = queue.take();
+        if (connection == nullptr) {
+            return;
+        }
+        connection->getDatabase().run(*connection);
+    }
+}
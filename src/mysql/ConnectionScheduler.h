@@ -0,0 +1,65 @@
+#ifndef CONNECTIONSCHEDULER_
+#define CONNECTIONSCHEDULER_
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../BlockingQueue.h"
+
+class DatabaseConnection;
+
+/* Process wide pool of threads that runs the queries of all databases.
+ * A connection is scheduled whenever its database has queued queries. A thread then takes it and runs
+ * queries on it, a connection is only ever run by a single thread at a time.
+ * Since every connection runs its queries one after another, a database with a single connection
+ * still runs its queries in the order they were started in.
+ * The pool has at most one thread per core, queries that wait for the server are parked by the ConnectionPoller.
+ * Prepared queries, transactions and other queries that block their thread until the server has responded are
+ * handed to a separate pool of up to BLOCKING_THREADS_PER_CORE threads per core instead, so they don't hold up
+ * the queries of other databases.
+ */
+class ConnectionScheduler {
+public:
+    static ConnectionScheduler &getInstance();
+
+    ConnectionScheduler(const ConnectionScheduler &) = delete;
+
+    ConnectionScheduler &operator=(const ConnectionScheduler &) = delete;
+
+    ~ConnectionScheduler();
+
+    void schedule(DatabaseConnection &connection);
+
+    void scheduleBlocking(DatabaseConnection &connection);
+
+    static bool canRunBlocking();
+
+    void addConnections(unsigned int count);
+
+    void removeConnection();
+
+    void shutdown();
+
+    bool isStopped();
+
+private:
+    ConnectionScheduler() = default;
+
+    static unsigned int coreCount();
+
+    static void runInline(DatabaseConnection &connection);
+
+    void run(BlockingQueue<DatabaseConnection *> &queue, bool blocking);
+
+    static constexpr unsigned int BLOCKING_THREADS_PER_CORE = 4;
+
+    BlockingQueue<DatabaseConnection *> readyConnections{};
+    BlockingQueue<DatabaseConnection *> blockingConnections{};
+    std::mutex m_threadMutex; //Protects threads, blockingThreads, connectionCount and stopped
+    std::vector<std::thread> threads{};
+    std::vector<std::thread> blockingThreads{};
+    unsigned int connectionCount = 0; //Connections of all databases that are connecting or connected
+    bool stopped = false;
+};
+
+#endif
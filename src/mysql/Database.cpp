@@ -4,6 +4,7 @@
 #include <iostream>
 #include <utility>
 #include "PingQuery.h"
+#include "ConnectionPoller.h"
 #include "mysql/mysqld_error.h"
 #include "../lua/LuaObject.h"
 #include "mysql/errmsg.h"
@@ -24,68 +25,51 @@ Database::createDatabase(const std::string &host, const std::string &username, c
 
 Database::~Database() {
     this->shutdown();
-    if (this->m_thread.joinable()) {
-        this->m_thread.join();
-    }
+    waitForConnections();
     LuaObject::allocationCount--;
 }
 
-
-//This makes sure that all stmts always get freed
-std::shared_ptr<StatementHandle> Database::cacheStatement(MYSQL_STMT *stmt) {
-    if (stmt == nullptr) return std::make_shared<StatementHandle>(nullptr, false);
-    std::unique_lock<std::mutex> lock(m_statementMutex);
-    auto handle = std::make_shared<StatementHandle>(stmt, true);
-    cachedStatements.insert(handle);
-    return handle;
-}
-
-//This notifies the database thread to free this statement some time in the future
-void Database::freeStatement(const std::shared_ptr<StatementHandle> &handle) {
-    if (handle == nullptr || !handle->isValid()) return;
-    std::unique_lock<std::mutex> lock(m_statementMutex);
-    if (cachedStatements.find(handle) != cachedStatements.end()) {
-        //Otherwise, the statement was already freed
-        cachedStatements.erase(handle);
-        freedStatements.insert(handle->stmt);
-    }
-    handle->invalidate();
-}
-
-//Frees all statements that were allocated by the database
-//This is called when the database shuts down or a reconnect happens
-void Database::freeCachedStatements() {
-    std::unique_lock<std::mutex> lock(m_statementMutex);
-    for (auto &handle: cachedStatements) {
-        if (handle == nullptr || !handle->isValid()) continue;
-        mysql_stmt_close(handle->stmt);
-        handle->invalidate();
+/* Enqueues a query into the queue of accepted queries.
+ */
+void Database::enqueueQuery(std::shared_ptr<IQuery> query, std::shared_ptr<IQueryData> queryData) {
+    //Set before the query is queued, since a connection thread might pick it up immediately
+    queryData->setStatus(QUERY_WAITING);
+    auto queryMaxQueueTime = query->getMaxQueueTime();
+    auto maxTime = queryMaxQueueTime.count() > 0 ? queryMaxQueueTime : this->maxQueueTime;
+    if (maxTime.count() > 0) {
+        queryData->setQueueDeadline(std::chrono::steady_clock::now() + maxTime);
     }
-    cachedStatements.clear();
-    for (auto &stmt: freedStatements) {
-        if (stmt == nullptr) continue;
-        mysql_stmt_close(stmt);
+    auto priority = query->getPriority();
+    {
+        //Checked while holding the lock, so no query can be queued after the poison pills
+        std::lock_guard<std::mutex> lock(m_shutdownMutex);
+        if (m_shutdownStarted) {
+            failWaitingQuery(query, queryData, "Database is disconnecting, queries can't be started anymore");
+            return;
+        }
+        queryQueue.put(std::make_pair(std::move(query), std::move(queryData)), priority);
     }
-    freedStatements.clear();
+    scheduleConnection();
 }
 
-//Frees all statements that have been marked as unused, i.e. the prepared query has been destroyed.
-//Called periodically by the database thread
-void Database::freeUnusedStatements() {
-    std::unique_lock<std::mutex> lock(m_statementMutex);
-    for (auto &stmt: freedStatements) {
-        //Even if this returns an error, the handle will be freed
-        mysql_stmt_close(stmt);
+/* Hands an idle connection to the scheduler, so the queued queries get run.
+ * Nothing happens if all connections are already busy, they pick up the query once they are done.
+ */
+void Database::scheduleConnection() {
+    for (auto &connection: m_connections) {
+        if (!connection->m_scheduled.exchange(true)) {
+            ConnectionScheduler::getInstance().schedule(*connection);
+            return;
+        }
     }
-    freedStatements.clear();
 }
 
-/* Enqueues a query into the queue of accepted queries.
- */
-void Database::enqueueQuery(const std::shared_ptr<IQuery> &query, const std::shared_ptr<IQueryData> &queryData) {
-    queryQueue.put(std::make_pair(query, queryData));
-    queryData->setStatus(QUERY_WAITING);
-    this->m_queryWakeupVariable.notify_one();
+void Database::scheduleAllConnections() {
+    for (auto &connection: m_connections) {
+        if (!connection->m_scheduled.exchange(true)) {
+            ConnectionScheduler::getInstance().schedule(*connection);
+        }
+    }
 }
 
 
@@ -127,15 +111,18 @@ void Database::wait() {
  */
 std::string Database::escape(const std::string &str) {
     //No query mutex needed since this doesn't use the connection at all
-    std::lock_guard<std::mutex> lock(m_connectMutex);
-    if (!m_connectionDone || m_sql == nullptr) {
+    std::unique_lock<std::mutex> lock(m_connectMutex);
+    //Blocks until the connection attempt is done, like the connection threads do
+    m_connectWakeupVariable.wait(lock, [this] { return !startedConnecting || m_connectionDone; });
+    MYSQL *sql = m_connections.empty() ? nullptr : m_connections.front()->m_sql;
+    if (!m_connectionDone || sql == nullptr) {
         throw MySQLOOException("Cannot escape using database that is not connected");
     }
 
     //escaped string can be twice as big as original string
     //source: http://dev.mysql.com/doc/refman/5.1/en/mysql-real-escape-string.html
     std::vector<char> escapedQuery(str.size() * 2 + 1);
-    unsigned int nEscapedQueryLength = mysql_real_escape_string(m_sql, escapedQuery.data(), str.c_str(),
+    unsigned int nEscapedQueryLength = mysql_real_escape_string(sql, escapedQuery.data(), str.c_str(),
                                                                 (unsigned long) str.size());
     return {escapedQuery.data(), (size_t) nEscapedQueryLength};
 }
@@ -149,16 +136,25 @@ bool Database::setCharacterSet(const std::string &characterSet) {
     if (this->m_status != DATABASE_CONNECTED) {
         throw MySQLOOException("Database needs to be connected to change charset.");
     }
-    //This mutex makes sure we can safely use the connection to run the query
-    std::unique_lock<std::mutex> lk2(m_queryMutex);
-    if (mysql_set_character_set(m_sql, characterSet.c_str())) {
-        return false;
-    } else {
-        return true;
+    bool success = true;
+    setStreamBackpressure(false);
+    auto restoreBackpressure = finally([&] { setStreamBackpressure(true); });
+    for (auto &connection: m_connections) {
+        //This mutex makes sure we can safely use the connection to run the query
+        std::unique_lock<std::mutex> lk2(connection->m_queryMutex);
+        //A non blocking query that is waiting for the server is still using the connection
+        connection->m_pendingQueryWakeupVariable.wait(lk2, [&] {
+            return connection->m_pendingQuery.first == nullptr;
+        });
+        if (connection->m_sql == nullptr || mysql_set_character_set(connection->m_sql, characterSet.c_str())) {
+            success = false;
+        }
     }
+    return success;
 }
 
-/* Starts the thread that connects to the database and then handles queries.
+/* Starts one thread per connection that connects to the database.
+ * The threads end once the connection attempt is done, queries are run by the ConnectionScheduler.
  */
 void Database::connect() {
     if (m_status != DATABASE_NOT_CONNECTED || startedConnecting) {
@@ -167,7 +163,15 @@ void Database::connect() {
     m_canWait = true;
     startedConnecting = true;
     m_status = DATABASE_CONNECTING;
-    m_thread = std::thread(&Database::connectRun, this);
+    //All connections need to exist before any thread starts, since the threads iterate them
+    for (unsigned int i = 0; i < m_connectionCount; i++) {
+        m_connections.push_back(std::make_unique<DatabaseConnection>(*this, i));
+    }
+    m_runningConnections = m_connectionCount;
+    ConnectionScheduler::getInstance().addConnections(m_connectionCount);
+    for (auto &connection: m_connections) {
+        connection->m_thread = std::thread(&Database::connectRun, this, std::ref(*connection));
+    }
 }
 
 void SSLSettings::applySSLSettings(MYSQL *m_sql) const {
@@ -200,8 +204,18 @@ void Database::setSSLSettings(const SSLSettings &settings) {
 
 
 void Database::shutdown() {
-    //This acts as a poison pill
-    this->queryQueue.put(std::make_pair(std::shared_ptr<IQuery>(), std::shared_ptr<IQueryData>()));
+    {
+        //Queries started from now on fail right away, so the connections reach the poison pills even under load
+        std::lock_guard<std::mutex> lock(m_shutdownMutex);
+        if (m_shutdownStarted) return;
+        m_shutdownStarted = true;
+        //This acts as a poison pill, every connection consumes exactly one of them
+        //They are only taken once all queued queries have been taken, regardless of their priority
+        for (unsigned int i = 0; i < m_connectionCount; i++) {
+            this->queryQueue.putLast(std::make_pair(std::shared_ptr<IQuery>(), std::shared_ptr<IQueryData>()));
+        }
+    }
+    scheduleAllConnections();
     //The fact that C++ can't automatically infer the types of the shared_ptr here and that
     //I have to specify what type it should be, just proves once again that C++ is a failed language
     //that should be replaced as soon as possible
@@ -209,12 +223,26 @@ void Database::shutdown() {
 
 /* Disconnects from the mysql database after finishing all queued queries
  * If wait is true, this will wait for the all queries to finish execution and the
- * database thread to end.
+ * connections to be closed.
  */
 void Database::disconnect(bool wait) {
     shutdown();
-    if (wait && m_thread.joinable()) {
-        m_thread.join();
+    if (!wait) return;
+    waitForConnections();
+}
+
+/* Blocks until every connection has been closed and the connection threads have ended.
+ */
+void Database::waitForConnections() {
+    setStreamBackpressure(false);
+    {
+        std::unique_lock<std::mutex> lock(m_connectMutex);
+        m_connectWakeupVariable.wait(lock, [this] { return m_runningConnections == 0; });
+    }
+    for (auto &connection: m_connections) {
+        if (connection->m_thread.joinable()) {
+            connection->m_thread.join();
+        }
     }
 }
 
@@ -295,16 +323,26 @@ bool Database::ping() {
     auto queryData = query->buildQueryData();
     query->start(queryData);
     query->wait(true);
-    //Ping queries do not have a lua correspondence, so they need to be removed from finished queries
+    //Ping queries do not have a lua correspondence, so they are never put into the finished queries
     //(they are essentially just a hack)
-    this->finishedQueries.removeIf(
-            [queryData](std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> const &p) {
-                return p.second == queryData;
-            });
     query->finishQueryData(queryData);
     return query->pingSuccess;
 }
 
+void Database::setCoalesceInserts(bool shouldCoalesce) {
+    if (this->m_status != DATABASE_NOT_CONNECTED || startedConnecting) {
+        throw MySQLOOException("setCoalesceInserts has to be called before db:start()!");
+    }
+    coalesceInserts = shouldCoalesce;
+}
+
+void Database::setBulkInserts(bool shouldBulkInsert) {
+    if (this->m_status != DATABASE_NOT_CONNECTED || startedConnecting) {
+        throw MySQLOOException("setBulkInserts has to be called before db:start()!");
+    }
+    bulkInserts = shouldBulkInsert;
+}
+
 //Set this to false if your database server imposes a low prepared statements limit
 //Or if you might create a very high amount of prepared queries in a short period of time
 void Database::setCachePreparedStatements(bool shouldCache) {
@@ -314,13 +352,80 @@ void Database::setCachePreparedStatements(bool shouldCache) {
     cachePreparedStatements = shouldCache;
 }
 
+/* Sets how many prepared statements each connection keeps cached, statements are shared by all prepared
+ * queries with the same sql. The size is further limited by the max_prepared_stmt_count of the server.
+ */
+void Database::setStatementCacheSize(unsigned int size) {
+    if (this->m_status != DATABASE_NOT_CONNECTED || startedConnecting) {
+        throw MySQLOOException("setStatementCacheSize has to be called before db:start()!");
+    }
+    statementCacheSize = size;
+}
+
+/* Sets the amount of connections the database uses to run queries.
+ * All connections take queries from the same queue, so if more than one connection is used
+ * queries are no longer guaranteed to be run in the order they were started in.
+ */
+void Database::setConnectionCount(unsigned int count) {
+    if (m_status != DATABASE_NOT_CONNECTED || startedConnecting) {
+        throw MySQLOOException("Database already connected.");
+    }
+    if (count == 0) {
+        throw MySQLOOException("Connection count must be at least 1");
+    }
+    m_connectionCount = count;
+}
+
 void Database::failWaitingQuery(const std::shared_ptr<IQuery> &query, const std::shared_ptr<IQueryData> &data,
                                 std::string reason) {
     data->setError(std::move(reason));
     data->setResultStatus(QUERY_ERROR);
     data->setStatus(QUERY_COMPLETE);
     data->setFinished(true);
-    finishedQueries.put(std::make_pair(query, data));
+    putFinishedQuery(std::make_pair(query, data));
+}
+
+/* Passes a chunk of rows of a streaming query to the main thread, called by the connection running the query.
+ * Blocks while MAX_PENDING_STREAMED_CHUNKS chunks of the query have not been taken by the main thread yet,
+ * so a large result set is never buffered as a whole. The limit does not apply while the main thread is blocked
+ * by the database itself (see setStreamBackpressure) or the module is being unloaded, since nobody takes chunks then.
+ */
+void Database::putStreamedResult(std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &&pair,
+                                 ResultData &&chunk) {
+    auto &queryData = dynamic_cast<QueryData &>(*pair.second);
+    {
+        std::unique_lock<std::mutex> lock(m_streamMutex);
+        while (m_streamBackpressure && queryData.getStreamedResultCount() >= MAX_PENDING_STREAMED_CHUNKS &&
+               !ConnectionScheduler::getInstance().isStopped()) {
+            //Woken up by the main thread, the timeout only makes sure that the unloading of the module is noticed
+            m_streamWakeupVariable.wait_for(lock, std::chrono::milliseconds(100));
+        }
+    }
+    queryData.addStreamedResult(std::move(chunk));
+    streamedQueries.put(std::move(pair));
+}
+
+//Called by the main thread after it took the streamed chunks of a query
+void Database::notifyStreamedResultsTaken() {
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+    }
+    m_streamWakeupVariable.notify_all();
+}
+
+//Disabled while the main thread waits for a connection, a streaming query could never finish otherwise
+void Database::setStreamBackpressure(bool enabled) {
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        m_streamBackpressure = enabled;
+    }
+    m_streamWakeupVariable.notify_all();
+}
+
+//Hands a finished query over to the main thread, which runs its callbacks in the think hook
+void Database::putFinishedQuery(std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &&pair) {
+    if (!pair.first->hasLuaCorrespondence()) return;
+    finishedQueries.put(std::move(pair));
 }
 
 /* Called when the database finishes running queries.
@@ -355,85 +460,107 @@ void Database::waitForQuery(const std::shared_ptr<IQuery> &query, const std::sha
             return; //No need to wait
         }
         this->m_waitingQuery = std::make_pair(query, data);
+        //The query might be queued behind a streaming query on the same connection
+        setStreamBackpressure(false);
         this->m_queryWaitWakeupVariable.wait(lock, [data] { return data->isFinished(); });
     }
+    setStreamBackpressure(true);
+}
+
+/* Called by each connection thread once its connection attempt is done.
+ * Blocks until every connection of the database has finished its attempt and returns
+ * whether all of them succeeded, i.e. whether the thread should start running queries.
+ */
+bool Database::finishConnectionAttempt(DatabaseConnection &connection, bool success) {
+    std::unique_lock<std::mutex> lock(this->m_connectMutex);
+    if (!success) {
+        if (m_success) {
+            //Only the first error is reported
+            m_connection_err = connection.m_sql == nullptr ? "Out of memory" : mysql_error(connection.m_sql);
+        }
+        m_success = false;
+    } else if (connection.getIndex() == 0) {
+        m_serverVersion = mysql_get_server_version(connection.m_sql);
+        m_serverInfo = mysql_get_server_info(connection.m_sql);
+        m_hostInfo = mysql_get_host_info(connection.m_sql);
+    }
+    if (++m_finishedConnectionAttempts < m_connections.size()) {
+        m_connectWakeupVariable.wait(lock, [this] { return m_connectionDone.load(); });
+        return m_success;
+    }
+    if (m_success) {
+        m_connection_err = "";
+        m_status = DATABASE_CONNECTED;
+    } else {
+        m_status = DATABASE_CONNECTION_FAILED;
+        this->abortWaitingQuery();
+    }
+    m_connectionDone = true;
+    m_connectWakeupVariable.notify_all();
+    return m_success;
 }
 
-bool Database::attemptConnection() {
-    this->applyTimeoutSettings();
-    if (sslMode.has_value()) {
-        const unsigned int chosenMode = this->sslMode.value();
-        mysql_options(m_sql, MYSQL_OPT_SSL_MODE, &chosenMode);
+/* Called once a connection has been closed, either because connecting failed or because it was shut down.
+ * The last connection to be closed marks the database as disconnected.
+ */
+void Database::finishConnection() {
+    ConnectionScheduler::getInstance().removeConnection();
+    std::unique_lock<std::mutex> lock(this->m_connectMutex);
+    if (--m_runningConnections != 0) return;
+    //Only now can we be sure that no connection will finish the waiting query anymore
+    this->abortWaitingQuery();
+    if (m_status == DATABASE_CONNECTED) {
+        m_status = DATABASE_NOT_CONNECTED;
+    }
+    disconnected = true;
+    //Notified while holding the lock, the database may be destroyed as soon as the lock is released
+    m_connectWakeupVariable.notify_all();
+}
+
+void Database::closeConnection(DatabaseConnection &connection) {
+    connection.freeCachedStatements();
+    std::unique_lock<std::mutex> queryMutex(connection.m_queryMutex);
+    if (connection.m_sql != nullptr) {
+        mysql_close(connection.m_sql);
+        connection.m_sql = nullptr;
     }
-    this->customSSLSettings.applySSLSettings(this->m_sql);
-    const char *socketStr = this->socket.empty() ? nullptr : this->socket.c_str();
-    unsigned long clientFlag = (this->useMultiStatements) ? CLIENT_MULTI_STATEMENTS : 0;
-    clientFlag |= CLIENT_MULTI_RESULTS;
-    const auto result = mysql_real_connect(this->m_sql, this->host.c_str(), this->username.c_str(), this->pw.c_str(),this->database.c_str(), this->port, socketStr, clientFlag);
-    return result != nullptr;
 }
 
-/* Thread that connects to the database, on success it continues to handle queries in the run method.
+/* Thread that connects a single connection to the database.
+ * On success the connection is handed to the ConnectionScheduler whenever queries are queued.
  */
-void Database::connectRun() {
+void Database::connectRun(DatabaseConnection &connection) {
     mysql_thread_init();
     auto threadEnd = finally([&] {
         mysql_thread_end();
-        if (m_status == DATABASE_CONNECTED) {
-            m_status = DATABASE_NOT_CONNECTED;
-        }
-        disconnected = true;
     });
-    {
-        auto connectionSignaler = finally([&] { m_connectWakeupVariable.notify_one(); });
-        std::lock_guard<std::mutex> lock(this->m_connectMutex);
-        this->m_sql = mysql_init(nullptr);
-        if (this->m_sql == nullptr) {
-            m_success = false;
-            m_connection_err = "Out of memory";
-            m_connectionDone = true;
-            m_status = DATABASE_CONNECTION_FAILED;
-            return;
-        }
-        if (!attemptConnection()) {
-            m_success = false;
-            m_connection_err = mysql_error(this->m_sql);
-            m_connectionDone = true;
-            m_status = DATABASE_CONNECTION_FAILED;
-            this->abortWaitingQuery();
-            return;
-        }
-        m_success = true;
-        m_connection_err = "";
-        m_connectionDone = true;
-        m_status = DATABASE_CONNECTED;
-        m_serverVersion = mysql_get_server_version(this->m_sql);
-        m_serverInfo = mysql_get_server_info(this->m_sql);
-        m_hostInfo = mysql_get_host_info(this->m_sql);
-    }
-    auto closeConnection = finally([&] {
-        std::unique_lock<std::mutex> queryMutex(m_queryMutex);
-        mysql_close(this->m_sql);
-        this->m_sql = nullptr;
-        this->abortWaitingQuery();
-    });
-    if (m_success) {
-        run();
+    connection.m_sql = mysql_init(nullptr);
+    bool success = connection.m_sql != nullptr && connection.attemptConnection();
+    if (!finishConnectionAttempt(connection, success)) {
+        closeConnection(connection);
+        finishConnection();
+        return;
+    }
+    //Queries (or poison pills) might have been queued while connecting
+    connection.m_scheduled = false;
+    if (!queryQueue.empty() && !connection.m_scheduled.exchange(true)) {
+        ConnectionScheduler::getInstance().schedule(connection);
     }
 }
 
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "misc-no-recursion"
-void Database::runQuery(const std::shared_ptr<IQuery>& query, const std::shared_ptr<IQueryData>& data, bool retry) {
+void Database::runQuery(DatabaseConnection &connection, const std::shared_ptr<IQuery> &query,
+                        const std::shared_ptr<IQueryData> &data, bool retry) {
     try {
-        query->executeStatement(*this, this->m_sql, data);
+        query->executeStatement(connection, connection.m_sql, data);
         data->setResultStatus(QUERY_SUCCESS);
     } catch (const MySQLException &error) {
-        if (retry && isRetriableError(error.getErrorCode()) && attemptReconnect()) {
+        if (retry && data->canRetry() && isRetriableError(error.getErrorCode()) && connection.attemptReconnect()) {
             //Need to free statements before retrying in case the connection was lost
             //and prepared statement handles have become invalid
-            freeCachedStatements();
-            runQuery(query, data, false);
+            connection.freeCachedStatements();
+            runQuery(connection, query, data, false);
         } else {
             data->setResultStatus(QUERY_ERROR);
             data->setError(error.what());
@@ -446,51 +573,224 @@ void Database::runQuery(const std::shared_ptr<IQuery>& query, const std::shared_
 }
 #pragma clang diagnostic pop
 
-/* The run method of the thread of the database instance.
+/* Runs queued queries on a connection, called by a thread of the ConnectionScheduler.
+ * At most MAX_QUERIES_PER_RUN queries are run before the connection is scheduled again,
+ * so the connections of other databases get their turn as well.
  */
-void Database::run() {
-    auto a = finally([&] {
-        this->freeCachedStatements();
-    });
-    while (true) {
-        auto pair = this->queryQueue.take();
-        //This detects the poison pill that is supposed to shut down the database
+void Database::run(DatabaseConnection &connection) {
+    //If the connection was scheduled by the ConnectionPoller, the server has responded to its pending query
+    if (!executeQuery(connection, std::make_pair(nullptr, nullptr))) {
+        return;
+    }
+    //Set if the connection was handed over to a thread that may block
+    auto pair = std::move(connection.m_blockingQuery);
+    for (unsigned int i = 0; i < MAX_QUERIES_PER_RUN; i++) {
         if (pair.first == nullptr) {
+            if (!this->queryQueue.tryTake(pair)) {
+                connection.m_scheduled = false;
+                //A query might have been queued after tryTake but before the flag was reset, in which case
+                //the connection was not scheduled for it.
+                if (this->queryQueue.empty() || connection.m_scheduled.exchange(true)) {
+                    return;
+                }
+                continue;
+            }
+            //This detects the poison pill that is supposed to shut down the database
+            //The connection stays marked as scheduled, so it is never run again
+            if (pair.first == nullptr) {
+                closeConnection(connection);
+                finishConnection();
+                return;
+            }
+        }
+        if (pair.second->hasQueueDeadlinePassed()) {
+            //Stale queries are dropped, so the queue is cleared quickly after the server was unavailable for a while
+            pair.second->setResultStatus(QUERY_EXPIRED);
+            pair.second->setError("Query expired before it could be run");
+            pair.second->setStatus(QUERY_COMPLETE);
+            finishQuery(std::move(pair));
+            pair = {};
+            continue;
+        }
+        if (!canRunNonBlocking(*pair.first, *pair.second) && !ConnectionScheduler::canRunBlocking()) {
+            connection.m_blockingQuery = std::move(pair);
+            ConnectionScheduler::getInstance().scheduleBlocking(connection);
             return;
         }
-        auto curQuery = pair.first;
-        auto data = pair.second;
-        {
-            //New scope so mutex will be released as soon as possible
-            std::unique_lock<std::mutex> queryMutex(m_queryMutex);
-            data->setStatus(QUERY_RUNNING);
-            runQuery(curQuery, data, this->shouldAutoReconnect);
-            data->setStatus(QUERY_COMPLETE);
+        if (this->coalesceInserts && tryCoalesceInserts(connection, pair)) {
+            pair = {};
+            continue;
+        }
+        pair.second->setStatus(QUERY_RUNNING);
+        if (!executeQuery(connection, std::move(pair))) {
+            //The connection is scheduled again by the ConnectionPoller once the server has responded
+            return;
+        }
+        pair = {};
+    }
+    ConnectionScheduler::getInstance().schedule(connection);
+}
+
+/* Runs a query on the connection and hands it over to the main thread once it is done.
+ * If an empty pair is passed, the pending query of the connection is continued instead (if there is one).
+ * Returns false if a non blocking query is waiting for the server, it then becomes the pending query of the connection.
+ */
+bool Database::executeQuery(DatabaseConnection &connection,
+                            std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &&pair) {
+    {
+        //New scope so mutex will be released as soon as possible
+        std::unique_lock<std::mutex> queryMutex(connection.m_queryMutex);
+        if (pair.first == nullptr) {
+            if (connection.m_pendingQuery.first == nullptr) {
+                return true;
+            }
+            pair = std::move(connection.m_pendingQuery);
         }
-        finishedQueries.put(pair);
-        {
-            //Notify waiting query
-            std::unique_lock<std::mutex> lock(this->m_queryWaitMutex);
-            data->setFinished(true);
-            auto waitingQuery = this->m_waitingQuery.first;
-            auto waitingData = this->m_waitingQuery.second;
-            if (waitingQuery == curQuery && waitingData == data) {
-                this->m_waitingQuery = std::make_pair(nullptr, nullptr);
+        if (canRunNonBlocking(*pair.first, *pair.second)) {
+            while (!runQueryNonBlocking(connection, pair.first, pair.second)) {
+                connection.m_pendingQuery = std::move(pair);
+                if (ConnectionPoller::getInstance().watch(connection)) {
+                    m_parkedQueries++;
+                    return false;
+                }
+                pair = std::move(connection.m_pendingQuery);
+                ConnectionPoller::waitForSocket(connection.m_sql);
             }
+        } else {
+            runQuery(connection, pair.first, pair.second, this->shouldAutoReconnect);
         }
-        this->m_queryWaitWakeupVariable.notify_all();
-        //So that statements get eventually freed even if the queue is constantly full
-        freeUnusedStatements();
+        connection.updateSessionVariables();
+        pair.second->setStatus(QUERY_COMPLETE);
     }
+    connection.m_pendingQueryWakeupVariable.notify_all();
+    finishQuery(std::move(pair));
+    return true;
 }
 
-bool Database::attemptReconnect() {
-    mysql_close(this->m_sql);
-    this->m_sql = mysql_init(nullptr);
-    if (this->m_sql == nullptr) {
+//Hands a query that is done over to the main thread and wakes up the main thread if it is waiting for it
+void Database::finishQuery(std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &&pair) {
+    {
+        //Notify waiting query
+        std::unique_lock<std::mutex> lock(this->m_queryWaitMutex);
+        pair.second->setFinished(true);
+        if (this->m_waitingQuery == pair) {
+            this->m_waitingQuery = std::make_pair(nullptr, nullptr);
+        }
+        //Handed over while holding the lock, so a woken up waiter always finds the query in the finished queue.
+        putFinishedQuery(std::move(pair));
+    }
+    this->m_queryWaitWakeupVariable.notify_all();
+}
+
+/* Takes the executions of the same single row insert that are queued directly after the query and runs all of them
+ * as a single multi row insert. Returns false if there are none, the query is then left in pair and has to be run on its own.
+ */
+bool Database::tryCoalesceInserts(DatabaseConnection &connection,
+                                  std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &pair) {
+    auto insert = std::dynamic_pointer_cast<PreparedQuery>(pair.first);
+    if (insert == nullptr || !insert->canCoalesce(*pair.second)) {
+        return false;
+    }
+    unsigned long long maxAllowedPacket;
+    {
+        std::unique_lock<std::mutex> queryMutex(connection.m_queryMutex);
+        if (!insert->insertsGeneratedIdsOnly(connection)) {
+            return false;
+        }
+        maxAllowedPacket = connection.getMaxAllowedPacket();
+    }
+    size_t statementSize = insert->m_coalescePrefix.size() + insert->estimateCoalescedRowSize(*pair.second);
+    std::vector<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> batch;
+    batch.push_back(std::move(pair));
+    auto canAddToBatch = [&](const std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &candidate) {
+        auto *other = dynamic_cast<PreparedQuery *>(candidate.first.get());
+        if (other == nullptr || other->m_query != insert->m_query || !other->canCoalesce(*candidate.second) ||
+            candidate.second->hasQueueDeadlinePassed()) {
+            return false;
+        }
+        size_t rowSize = other->estimateCoalescedRowSize(*candidate.second);
+        if (!insert->fitsIntoInsert(batch.size() + 1, statementSize + rowSize, maxAllowedPacket)) {
+            return false;
+        }
+        statementSize += rowSize;
+        return true;
+    };
+    std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> next;
+    while (this->queryQueue.tryTakeIf(next, canAddToBatch)) {
+        batch.push_back(std::move(next));
+    }
+    if (batch.size() == 1) {
+        pair = std::move(batch.front());
         return false;
     }
-    return attemptConnection();
+    runCoalescedInserts(connection, std::move(batch));
+    return true;
+}
+
+void Database::runCoalescedInserts(DatabaseConnection &connection,
+                                   std::vector<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> &&batch) {
+    for (auto &pair: batch) {
+        pair.second->setStatus(QUERY_RUNNING);
+    }
+    bool inserted = false;
+    bool failed = false;
+    std::string error;
+    {
+        std::unique_lock<std::mutex> queryMutex(connection.m_queryMutex);
+        try {
+            auto insert = std::static_pointer_cast<PreparedQuery>(batch.front().first);
+            inserted = insert->executeCoalescedInserts(connection, connection.m_sql, batch);
+        } catch (const std::exception &exception) {
+            failed = true;
+            error = exception.what();
+        }
+    }
+    for (auto &pair: batch) {
+        if (inserted) {
+            pair.second->setStatus(QUERY_COMPLETE);
+            finishQuery(std::move(pair));
+        } else if (failed) {
+            //Some or all of the rows might have been inserted, running the inserts again could insert them twice
+            pair.second->setResultStatus(QUERY_ERROR);
+            pair.second->setError(error);
+            pair.second->setStatus(QUERY_COMPLETE);
+            finishQuery(std::move(pair));
+        } else {
+            //Nothing was inserted, the inserts are run one by one instead, so only the ones that caused the error fail.
+            //This also reconnects if the connection was lost.
+            executeQuery(connection, std::move(pair));
+        }
+    }
+}
+
+//The non blocking api is only used if the server doesn't need to respond within the read timeout
+bool Database::canRunNonBlocking(const IQuery &query, const IQueryData &data) const {
+    return ConnectionPoller::isSupported() && this->readTimeout == 0 && query.canRunNonBlocking(data);
+}
+
+//Returns false if the query has to wait for the server, it has to be called again once the connection is readable
+bool Database::runQueryNonBlocking(DatabaseConnection &connection, const std::shared_ptr<IQuery> &query,
+                                   const std::shared_ptr<IQueryData> &data) {
+    try {
+        if (!query->executeStatementNonBlocking(connection, connection.m_sql, data)) {
+            return false;
+        }
+        data->setResultStatus(QUERY_SUCCESS);
+    } catch (const MySQLException &error) {
+        if (this->shouldAutoReconnect && data->canRetry() && isRetriableError(error.getErrorCode()) &&
+            connection.attemptReconnect()) {
+            connection.freeCachedStatements();
+            //The connection was just reestablished with the blocking api anyway, so the retry uses it as well
+            runQuery(connection, query, data, false);
+        } else {
+            data->setResultStatus(QUERY_ERROR);
+            data->setError(error.what());
+        }
+    } catch (const std::exception &error) {
+        data->setResultStatus(QUERY_ERROR);
+        data->setError(error.what());
+    }
+    return true;
 }
 
 bool Database::isRetriableError(const unsigned int errorCode) {
@@ -524,15 +824,15 @@ void Database::setSSLMode(mysql_ssl_mode newSSLMode) {
     this->sslMode = newSSLMode;
 }
 
-void Database::applyTimeoutSettings() {
+void Database::applyTimeoutSettings(MYSQL *sql) const {
     if (this->connectTimeout > 0) {
-        mysql_options(this->m_sql, MYSQL_OPT_CONNECT_TIMEOUT, &this->connectTimeout);
+        mysql_options(sql, MYSQL_OPT_CONNECT_TIMEOUT, &this->connectTimeout);
     }
     if (this->readTimeout > 0) {
-        mysql_options(this->m_sql, MYSQL_OPT_READ_TIMEOUT, &this->readTimeout);
+        mysql_options(sql, MYSQL_OPT_READ_TIMEOUT, &this->readTimeout);
     }
     if (this->writeTimeout > 0) {
-        mysql_options(this->m_sql, MYSQL_OPT_WRITE_TIMEOUT, &this->writeTimeout);
+        mysql_options(sql, MYSQL_OPT_WRITE_TIMEOUT, &this->writeTimeout);
     }
 }
 
@@ -7,16 +7,20 @@
 #include <future>
 #include <memory>
 #include <mutex>
-#include "StatementHandle.h"
 #include <unordered_set>
 #include <condition_variable>
 #include <optional>
+#include <vector>
 
 #include "../BlockingQueue.h"
+#include "../MPSCQueue.h"
+#include "../PriorityQueue.h"
 #include "Query.h"
 #include "PreparedQuery.h"
 #include "IQuery.h"
 #include "Transaction.h"
+#include "DatabaseConnection.h"
+#include "ConnectionScheduler.h"
 
 struct SSLSettings {
     std::string key;
@@ -39,6 +43,10 @@ enum DatabaseStatus {
 class Database : public std::enable_shared_from_this<Database> {
     friend class IQuery;
 
+    friend class DatabaseConnection;
+
+    friend class ConnectionScheduler;
+
 public:
     static std::shared_ptr<Database>
     createDatabase(const std::string &host, const std::string &username, const std::string &pw,
@@ -47,11 +55,7 @@ public:
 
     ~Database();
 
-    std::shared_ptr<StatementHandle> cacheStatement(MYSQL_STMT *stmt);
-
-    void freeStatement(const std::shared_ptr<StatementHandle> &handle);
-
-    void enqueueQuery(const std::shared_ptr<IQuery> &query, const std::shared_ptr<IQueryData> &data);
+    void enqueueQuery(std::shared_ptr<IQuery> query, std::shared_ptr<IQueryData> data);
 
     void setShouldAutoReconnect(bool autoReconnect);
 
@@ -91,6 +95,25 @@ public:
 
     void setCachePreparedStatements(bool cachePreparedStatements);
 
+    void setCoalesceInserts(bool coalesceInserts);
+
+    void setBulkInserts(bool bulkInserts);
+
+    bool shouldBulkInsert() const { return bulkInserts; }
+
+    void setStatementCacheSize(unsigned int size);
+
+    unsigned long long statementCacheHitCount() const { return statementCacheHits; }
+
+    unsigned long long statementCacheMissCount() const { return statementCacheMisses; }
+
+    //Amount of times a query waited for the server without occupying a thread, see ConnectionPoller
+    unsigned long long parkedQueryCount() const { return m_parkedQueries; }
+
+    void setConnectionCount(unsigned int count);
+
+    unsigned int connectionCount() const { return m_connectionCount; }
+
     void disconnect(bool wait);
 
     void setConnectTimeout(unsigned int timeout);
@@ -99,6 +122,8 @@ public:
 
     void setWriteTimeout(unsigned int timeout);
 
+    void setMaxQueueTime(std::chrono::milliseconds maxQueueTime) { this->maxQueueTime = maxQueueTime; }
+
     void setSSLMode(mysql_ssl_mode newSSLMode);
 
     void setSSLSettings(const SSLSettings &settings);
@@ -107,32 +132,74 @@ public:
 
     bool connectionSuccessful() { return m_success; }
 
-    bool attemptReconnect();
-
     static bool isRetriableError(unsigned int errorCode);
 
     std::string connectionError() { return m_connection_err; }
 
-    std::deque<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> takeFinishedQueries() {
-        return finishedQueries.clear();
+    template<typename Container>
+    void takeFinishedQueries(Container &out) {
+        finishedQueries.takeAll(out);
+    }
+
+    void putStreamedResult(std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &&pair, ResultData &&chunk);
+
+    void notifyStreamedResultsTaken();
+
+    template<typename Container>
+    void takeStreamedQueries(Container &out) {
+        streamedQueries.takeAll(out);
     }
 
     bool wasDisconnected();
 private:
+    //Maximum amount of queries a connection runs before other connections get their turn on the scheduler threads
+    static constexpr unsigned int MAX_QUERIES_PER_RUN = 16;
+    //Queued queries of a lower priority are run after at most this many queries of higher priorities
+    static constexpr unsigned int MAX_PRIORITY_SKIPS = 8;
+    //Maximum amount of fetched chunks of a streaming query that the main thread has not taken yet
+    static constexpr size_t MAX_PENDING_STREAMED_CHUNKS = 4;
+    //Amount of prepared statements each connection keeps cached by default
+    static constexpr unsigned int DEFAULT_STATEMENT_CACHE_SIZE = 64;
+
     Database(std::string host, std::string username, std::string pw, std::string database, unsigned int port,
              std::string unixSocket);
 
     void shutdown();
 
-    void freeCachedStatements();
+    void run(DatabaseConnection &connection);
+
+    void scheduleConnection();
+
+    void scheduleAllConnections();
+
+    void closeConnection(DatabaseConnection &connection);
+
+    void waitForConnections();
 
-    void freeUnusedStatements();
+    void runQuery(DatabaseConnection &connection, const std::shared_ptr<IQuery> &query,
+                  const std::shared_ptr<IQueryData> &data, bool retry);
 
-    void run();
+    bool executeQuery(DatabaseConnection &connection,
+                      std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &&pair);
 
-    void runQuery(const std::shared_ptr<IQuery> &query, const std::shared_ptr<IQueryData> &data, bool retry);
+    void finishQuery(std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &&pair);
 
-    void connectRun();
+    bool tryCoalesceInserts(DatabaseConnection &connection,
+                            std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &pair);
+
+    void runCoalescedInserts(DatabaseConnection &connection,
+                             std::vector<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> &&batch);
+
+    bool canRunNonBlocking(const IQuery &query, const IQueryData &data) const;
+
+    bool runQueryNonBlocking(DatabaseConnection &connection, const std::shared_ptr<IQuery> &query,
+                             const std::shared_ptr<IQueryData> &data);
+
+    void connectRun(DatabaseConnection &connection);
+
+    bool finishConnectionAttempt(DatabaseConnection &connection, bool success);
+
+    void finishConnection();
 
     void abortWaitingQuery();
 
@@ -141,19 +208,20 @@ private:
 
     void waitForQuery(const std::shared_ptr<IQuery> &query, const std::shared_ptr<IQueryData> &data);
 
-    void applyTimeoutSettings();
+    void applyTimeoutSettings(MYSQL *sql) const;
+
+    void putFinishedQuery(std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> &&pair);
 
-    bool attemptConnection();
+    void setStreamBackpressure(bool enabled);
 
-    BlockingQueue<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> finishedQueries{};
-    BlockingQueue<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> queryQueue{};
-    std::unordered_set<std::shared_ptr<StatementHandle>> cachedStatements{};
-    std::unordered_set<MYSQL_STMT *> freedStatements{};
-    MYSQL *m_sql = nullptr;
-    std::thread m_thread;
+    MPSCQueue<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> finishedQueries{};
+    MPSCQueue<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> streamedQueries{};
+    PriorityQueue<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>, PRIORITY_HIGH + 1> queryQueue{
+            MAX_PRIORITY_SKIPS};
+    std::vector<std::unique_ptr<DatabaseConnection>> m_connections{};
     std::mutex m_connectMutex; //Mutex used during connection
-    std::mutex m_queryMutex; //Mutex that is locked while query thread operates on m_sql object
-    std::mutex m_statementMutex; //Mutex that protects cached prepared statements
+    std::mutex m_shutdownMutex; //Protects m_shutdownStarted, held while queueing queries
+    bool m_shutdownStarted = false;
     std::mutex m_queryWaitMutex; //Mutex that prevents deadlocks when calling :wait()
     std::condition_variable m_connectWakeupVariable;
     unsigned int m_serverVersion = 0;
@@ -162,15 +230,26 @@ private:
     std::string m_connection_err;
     bool shouldAutoReconnect = true;
     bool useMultiStatements = true;
+    bool coalesceInserts = false;
+    bool bulkInserts = false;
+    unsigned int statementCacheSize = DEFAULT_STATEMENT_CACHE_SIZE;
     bool startedConnecting = false;
     bool m_canWait = false;
+    unsigned int m_connectionCount = 1;
+    unsigned int m_finishedConnectionAttempts = 0; //Protected by m_connectMutex
+    std::atomic<unsigned int> m_runningConnections{0};
     std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> m_waitingQuery = {nullptr, nullptr};
     std::atomic<bool> m_success{true};
     std::atomic<bool> disconnected { false };
     std::atomic<bool> m_connectionDone{false};
     std::atomic<bool> cachePreparedStatements{true};
-    std::condition_variable m_queryWakeupVariable{};
+    std::atomic<unsigned long long> statementCacheHits{0};
+    std::atomic<unsigned long long> statementCacheMisses{0};
+    std::atomic<unsigned long long> m_parkedQueries{0};
     std::condition_variable m_queryWaitWakeupVariable{};
+    std::mutex m_streamMutex; //Protects m_streamBackpressure
+    std::condition_variable m_streamWakeupVariable{}; //Notified whenever the main thread took streamed chunks
+    bool m_streamBackpressure = true; //False while the main thread is blocked and can't take streamed chunks
     std::string database;
     std::string host;
     std::string username;
@@ -182,6 +261,7 @@ private:
     unsigned int readTimeout = 0;
     unsigned int writeTimeout = 0;
     unsigned int connectTimeout = 0;
+    std::chrono::milliseconds maxQueueTime{0}; //Queries that waited longer in the queue expire, 0 means never
     std::atomic<DatabaseStatus> m_status{DATABASE_NOT_CONNECTED};
 };
 
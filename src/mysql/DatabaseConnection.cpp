@@ -0,0 +1,178 @@
+#include "DatabaseConnection.h"
+#include "Database.h"
+#include <cstdlib>
+#include <algorithm>
+
+DatabaseConnection::DatabaseConnection(Database &database, unsigned int index) : m_database(database),
+                                                                                 m_index(index) {
+}
+
+//Returns the statement prepared for this sql on this connection and marks it as most recently used
+std::shared_ptr<StatementHandle> DatabaseConnection::getCachedStatement(const std::string &sql) {
+    auto it = cachedStatementLookup.find(sql);
+    if (it == cachedStatementLookup.end()) {
+        m_database.statementCacheMisses++;
+        return nullptr;
+    }
+    m_database.statementCacheHits++;
+    cachedStatements.splice(cachedStatements.begin(), cachedStatements, it->second);
+    return it->second->second;
+}
+
+//Takes ownership of the statement, the least recently used statements are closed if the cache is full
+std::shared_ptr<StatementHandle> DatabaseConnection::cacheStatement(const std::string &sql, MYSQL_STMT *stmt) {
+    evictStatement(sql);
+    auto handle = std::make_shared<StatementHandle>(stmt, true);
+    cachedStatements.emplace_front(sql, handle);
+    cachedStatementLookup.emplace(cachedStatements.front().first, cachedStatements.begin());
+    const size_t capacity = statementCacheCapacity();
+    while (cachedStatements.size() > capacity) {
+        evictStatement(cachedStatements.back().first);
+    }
+    return handle;
+}
+
+void DatabaseConnection::evictStatement(const std::string &sql) {
+    auto it = cachedStatementLookup.find(sql);
+    if (it == cachedStatementLookup.end()) return;
+    auto entry = it->second;
+    cachedStatementLookup.erase(it);
+    //Even if this returns an error, the handle will be freed
+    mysql_stmt_close(entry->second->stmt);
+    entry->second->invalidate();
+    cachedStatements.erase(entry);
+}
+
+//Frees all statements that were allocated by this connection
+//This is called when the database shuts down or a reconnect happens
+void DatabaseConnection::freeCachedStatements() {
+    for (auto &entry: cachedStatements) {
+        mysql_stmt_close(entry.second->stmt);
+        entry.second->invalidate();
+    }
+    cachedStatementLookup.clear();
+    cachedStatements.clear();
+}
+
+/* The server limits the amount of prepared statements of all its clients combined (max_prepared_stmt_count).
+ * The share of a connection assumes that this database is the only client of the server and only half of it is used,
+ * servers that are shared with other clients need a smaller statement cache size.
+ */
+size_t DatabaseConnection::statementCacheCapacity() {
+    const unsigned long long connectionCount = m_database.connectionCount();
+    const unsigned long long serverShare = getMaxPreparedStatementCount() / (2 * connectionCount);
+    return (size_t) std::max(1ull, std::min<unsigned long long>(m_database.statementCacheSize, serverShare));
+}
+
+bool DatabaseConnection::attemptConnection() {
+    const Database &database = this->m_database;
+    database.applyTimeoutSettings(this->m_sql);
+    if (database.sslMode.has_value()) {
+        const unsigned int chosenMode = database.sslMode.value();
+        mysql_options(m_sql, MYSQL_OPT_SSL_MODE, &chosenMode);
+    }
+    database.customSSLSettings.applySSLSettings(this->m_sql);
+    const char *socketStr = database.socket.empty() ? nullptr : database.socket.c_str();
+    unsigned long clientFlag = (database.useMultiStatements) ? CLIENT_MULTI_STATEMENTS : 0;
+    clientFlag |= CLIENT_MULTI_RESULTS | CLIENT_SESSION_TRACK;
+    const auto result = mysql_real_connect(this->m_sql, database.host.c_str(), database.username.c_str(),
+                                           database.pw.c_str(), database.database.c_str(), database.port,
+                                           socketStr, clientFlag);
+    if (result == nullptr) {
+        return false;
+    }
+    //Loaded right away, so reading them never has to interrupt a query
+    loadServerLimits();
+    return true;
+}
+
+/* Reads the server settings that limit multi row inserts and cached statements, the defaults are kept if this fails.
+ * The server is asked to report changes of auto_increment_increment along with the results of queries,
+ * so it stays up to date if a query changes it (see updateSessionVariables).
+ */
+void DatabaseConnection::loadServerLimits() {
+    const std::string trackQuery = "SET SESSION session_track_system_variables = "
+                                   "IF(@@session.session_track_system_variables = '*', '*', "
+                                   "CONCAT_WS(',', NULLIF(@@session.session_track_system_variables, ''), "
+                                   "'auto_increment_increment'))";
+    //Fails on servers that don't support tracking session variables, the increment is then only read here
+    mysql_real_query(m_sql, trackQuery.c_str(), (unsigned long) trackQuery.length());
+    const std::string query = "SELECT @@max_allowed_packet, @@session.auto_increment_increment, @@max_prepared_stmt_count";
+    if (mysql_real_query(m_sql, query.c_str(), (unsigned long) query.length()) != 0) {
+        return;
+    }
+    MYSQL_RES *result = mysql_store_result(m_sql);
+    if (result == nullptr) {
+        return;
+    }
+    auto resultFree = finally([&] { mysql_free_result(result); });
+    MYSQL_ROW row = mysql_fetch_row(result);
+    if (row == nullptr || row[0] == nullptr || row[1] == nullptr || row[2] == nullptr) {
+        return;
+    }
+    m_maxAllowedPacket = std::strtoull(row[0], nullptr, 10);
+    m_autoIncrementIncrement = std::max(1ull, std::strtoull(row[1], nullptr, 10));
+    m_maxPreparedStatementCount = std::strtoull(row[2], nullptr, 10);
+}
+
+//Picks up the session variables that the last statement changed, the server reports them as name and value pairs
+void DatabaseConnection::updateSessionVariables() {
+    const char *data;
+    size_t length;
+    if (mysql_session_track_get_first(m_sql, SESSION_TRACK_SYSTEM_VARIABLES, &data, &length) != 0) {
+        return;
+    }
+    do {
+        const std::string name(data, length);
+        if (mysql_session_track_get_next(m_sql, SESSION_TRACK_SYSTEM_VARIABLES, &data, &length) != 0) {
+            return;
+        }
+        if (name == "auto_increment_increment") {
+            m_autoIncrementIncrement = std::max(1ull, std::strtoull(std::string(data, length).c_str(), nullptr, 10));
+        }
+    } while (mysql_session_track_get_next(m_sql, SESSION_TRACK_SYSTEM_VARIABLES, &data, &length) == 0);
+}
+
+/* The statement is only prepared and never executed, the column flags are part of its result metadata.
+ * If it can't be prepared (e.g. a syntax the probe doesn't understand), the column is assumed to be selected.
+ */
+bool DatabaseConnection::selectsAutoIncrementColumn(const std::string &sql) {
+    auto it = m_autoIncrementColumns.find(sql);
+    if (it != m_autoIncrementColumns.end()) {
+        return it->second;
+    }
+    bool selectsColumn = true;
+    MYSQL_STMT *stmt = mysql_stmt_init(m_sql);
+    if (stmt != nullptr) {
+        auto stmtClose = finally([&] { mysql_stmt_close(stmt); });
+        if (mysql_stmt_prepare(stmt, sql.c_str(), (unsigned long) sql.length()) == 0) {
+            MYSQL_RES *metaData = mysql_stmt_result_metadata(stmt);
+            if (metaData != nullptr) {
+                auto metaDataFree = finally([&] { mysql_free_result(metaData); });
+                selectsColumn = false;
+                MYSQL_FIELD *fields = mysql_fetch_fields(metaData);
+                for (unsigned int i = 0; i < mysql_num_fields(metaData); i++) {
+                    if ((fields[i].flags & AUTO_INCREMENT_FLAG) != 0) {
+                        selectsColumn = true;
+                    }
+                }
+            }
+        }
+    }
+    //Every different insert adds an entry, this keeps applications that build their sql dynamically from growing it forever
+    if (m_autoIncrementColumns.size() >= 1024) {
+        m_autoIncrementColumns.clear();
+    }
+    m_autoIncrementColumns.emplace(sql, selectsColumn);
+    return selectsColumn;
+}
+
+bool DatabaseConnection::attemptReconnect() {
+    m_autoIncrementColumns.clear();
+    mysql_close(this->m_sql);
+    this->m_sql = mysql_init(nullptr);
+    if (this->m_sql == nullptr) {
+        return false;
+    }
+    return attemptConnection();
+}
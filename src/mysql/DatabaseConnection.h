@@ -0,0 +1,101 @@
+#ifndef DATABASECONNECTION_
+#define DATABASECONNECTION_
+
+#include "MySQLHeader.h"
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <unordered_map>
+#include <list>
+#include <string>
+#include <string_view>
+#include "StatementHandle.h"
+
+class Database;
+
+class IQuery;
+
+class IQueryData;
+
+/* A single connection to the mysql server.
+ * A database owns one or more of these, all of which take queries from the same queue of the database.
+ * The connection is established on its own short lived thread, afterwards its queries are run by the
+ * threads of the ConnectionScheduler.
+ */
+class DatabaseConnection {
+    friend class Database;
+
+    friend class ConnectionPoller;
+
+public:
+    DatabaseConnection(Database &database, unsigned int index);
+
+    DatabaseConnection(const DatabaseConnection &) = delete;
+
+    DatabaseConnection &operator=(const DatabaseConnection &) = delete;
+
+    //Prepared statement cache shared by all prepared queries with the same sql, only used by the connection's worker
+    std::shared_ptr<StatementHandle> getCachedStatement(const std::string &sql);
+
+    std::shared_ptr<StatementHandle> cacheStatement(const std::string &sql, MYSQL_STMT *stmt);
+
+    void evictStatement(const std::string &sql);
+
+    bool attemptReconnect();
+
+    Database &getDatabase() { return m_database; }
+
+    //Server settings that limit multi row inserts and cached statements, loaded when connecting.
+    //m_queryMutex has to be locked.
+    unsigned long long getMaxAllowedPacket() const { return m_maxAllowedPacket; }
+
+    //Kept up to date by updateSessionVariables. m_queryMutex has to be locked.
+    unsigned long long getAutoIncrementIncrement() const { return m_autoIncrementIncrement; }
+
+    void updateSessionVariables();
+
+    unsigned long long getMaxPreparedStatementCount() const { return m_maxPreparedStatementCount; }
+
+    //Whether any of the columns selected by the statement is an AUTO_INCREMENT column, true if that can't be found out.
+    //m_queryMutex has to be locked.
+    bool selectsAutoIncrementColumn(const std::string &sql);
+
+    unsigned int getIndex() const { return m_index; }
+
+private:
+    bool attemptConnection();
+
+    void freeCachedStatements();
+
+    void loadServerLimits();
+
+    size_t statementCacheCapacity();
+
+    Database &m_database;
+    unsigned int m_index;
+    MYSQL *m_sql = nullptr;
+    std::thread m_thread; //Only used while connecting
+    //True while the connection is queued in or run by the scheduler, the connection must not be scheduled then.
+    //Also true before the connection is established and after it was closed.
+    std::atomic<bool> m_scheduled{true};
+    std::mutex m_queryMutex; //Mutex that is locked while the connection thread operates on m_sql object
+    //Non blocking query that is waiting for the server, protected by m_queryMutex.
+    //The connection must not be used for anything else until it has finished.
+    std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> m_pendingQuery{};
+    std::condition_variable m_pendingQueryWakeupVariable; //Notified once the pending query has finished
+    //Query that blocks its thread, set while the connection is handed over to the blocking threads of the scheduler.
+    //Only used by the thread that runs the connection.
+    std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>> m_blockingQuery{};
+    //Cached statements ordered from most to least recently used, the keys of the lookup point into the list entries
+    std::list<std::pair<std::string, std::shared_ptr<StatementHandle>>> cachedStatements{};
+    std::unordered_map<std::string_view, decltype(cachedStatements)::iterator> cachedStatementLookup{};
+    //Results of selectsAutoIncrementColumn, cleared when reconnecting
+    std::unordered_map<std::string, bool> m_autoIncrementColumns{};
+    unsigned long long m_maxAllowedPacket = 1024 * 1024;
+    unsigned long long m_autoIncrementIncrement = 1;
+    unsigned long long m_maxPreparedStatementCount = 16382;
+};
+
+#endif
@@ -85,12 +85,23 @@ std::vector<std::shared_ptr<IQueryData>> IQuery::abort() {
     return abortedQueries;
 }
 
+//Sets the priority the query is queued with, only affects queries started afterwards
+void IQuery::setPriority(int priority) {
+    if (priority != PRIORITY_LOW && priority != PRIORITY_NORMAL && priority != PRIORITY_HIGH) {
+        throw MySQLOOException("Invalid Priority");
+    }
+    m_priority = (QueryPriority) priority;
+}
+
 //Sets several query options
 void IQuery::setOption(int option, bool enabled) {
     if (option != OPTION_NUMERIC_FIELDS &&
         option != OPTION_NAMED_FIELDS &&
         option != OPTION_INTERPRET_DATA &&
-        option != OPTION_CACHE) {
+        option != OPTION_CACHE &&
+        option != OPTION_STREAM_RESULTS &&
+        option != OPTION_LAZY_ROWS &&
+        option != OPTION_COLUMNAR) {
         throw MySQLOOException("Invalid Option");
     }
 
@@ -125,6 +136,18 @@ MYSQL_RES *IQuery::mysqlStoreResults(MYSQL *sql) {
     return result;
 }
 
+MYSQL_RES *IQuery::mysqlUseResults(MYSQL *sql) {
+    MYSQL_RES *result = mysql_use_result(sql);
+    if (result == nullptr) {
+        unsigned int errorCode = mysql_errno(sql);
+        if (errorCode != 0) {
+            const char *errorMessage = mysql_error(sql);
+            throw MySQLException(errorCode, errorMessage);
+        }
+    }
+    return result;
+}
+
 bool IQuery::mysqlNextResult(MYSQL *sql) {
     int result = mysql_next_result(sql);
     if (result == 0) return true;
@@ -162,10 +185,9 @@ void IQueryData::setResultStatus(QueryResultStatus status) {
 }
 
 //Queues the query into the queue of the database instance associated with it
-void IQuery::start(const std::shared_ptr<IQueryData> &queryData) {
-    auto db = m_database;
+void IQuery::start(std::shared_ptr<IQueryData> queryData) {
     addQueryData(queryData);
-    db->enqueueQuery(shared_from_this(), queryData);
+    m_database->enqueueQuery(shared_from_this(), std::move(queryData));
     hasBeenStarted = true;
 }
 
@@ -207,9 +229,13 @@ void IQueryData::finishLuaQueryData(ILuaBase *LUA, const std::shared_ptr <IQuery
     if (m_successReference) {
         LuaReferenceFree(LUA, m_successReference);
     }
+    if (m_coroutineReference) {
+        LuaReferenceFree(LUA, m_coroutineReference);
+    }
     m_onDataReference = 0;
     m_errorReference = 0;
     m_abortReference = 0;
     m_successReference = 0;
     m_tableReference = 0;
+    m_coroutineReference = 0;
 }
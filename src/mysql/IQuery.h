@@ -10,9 +10,12 @@
 #include <vector>
 #include <condition_variable>
 #include <stdexcept>
+#include <chrono>
 
 class Database;
 
+class DatabaseConnection;
+
 enum QueryStatus {
     QUERY_NOT_RUNNING = 0,
     QUERY_RUNNING = 1,
@@ -23,13 +26,22 @@ enum QueryStatus {
 enum QueryResultStatus {
     QUERY_NONE = 0,
     QUERY_ERROR,
-    QUERY_SUCCESS
+    QUERY_SUCCESS,
+    QUERY_EXPIRED //Query was not run since it waited in the queue for too long
 };
 enum {
     OPTION_NUMERIC_FIELDS = 1,
     OPTION_NAMED_FIELDS = 2,
     OPTION_INTERPRET_DATA = 4,
     OPTION_CACHE = 8,
+    OPTION_STREAM_RESULTS = 16,
+    OPTION_LAZY_ROWS = 32,
+    OPTION_COLUMNAR = 64,
+};
+enum QueryPriority {
+    PRIORITY_LOW = 0,
+    PRIORITY_NORMAL = 1,
+    PRIORITY_HIGH = 2,
 };
 
 class IQueryData;
@@ -58,7 +70,7 @@ public:
         callbackQueryData = std::move(data);
     }
 
-    void start(const std::shared_ptr<IQueryData> &queryData);
+    void start(std::shared_ptr<IQueryData> queryData);
 
     bool isRunning();
 
@@ -68,6 +80,20 @@ public:
         return m_options & option;
     }
 
+    void setPriority(int priority);
+
+    void setMaxQueueTime(std::chrono::milliseconds maxQueueTime) {
+        m_maxQueueTime = maxQueueTime;
+    }
+
+    std::chrono::milliseconds getMaxQueueTime() const {
+        return m_maxQueueTime;
+    }
+
+    QueryPriority getPriority() const {
+        return m_priority;
+    }
+
     void addQueryData(const std::shared_ptr<IQueryData> &data);
 
     void finishQueryData(const std::shared_ptr<IQueryData> &data);
@@ -78,6 +104,9 @@ public:
 
     virtual std::string getSQLString() = 0;
 
+    //Queries without a lua correspondence never have their callbacks run by the think hook
+    virtual bool hasLuaCorrespondence() const { return true; }
+
     void wait(bool shouldSwap);
 
     bool hasCallbackData() const {
@@ -93,18 +122,33 @@ public:
     virtual void runAbortedCallback(GarrysMod::Lua::ILuaBase *LUA, const std::shared_ptr<IQueryData> &data) {};
 protected:
 
-    virtual void executeStatement(Database &database, MYSQL *m_sql, const std::shared_ptr<IQueryData>& data) = 0;
+    virtual void executeStatement(DatabaseConnection &databaseConnection, MYSQL *m_sql, const std::shared_ptr<IQueryData>& data) = 0;
+
+    //Queries that don't need to block a thread while the server processes them (see ConnectionPoller)
+    virtual bool canRunNonBlocking(const IQueryData &data) const { return false; }
+
+    //Runs as much of the query as possible without blocking, returns false if it has to wait for the server.
+    //It is called again with the same data once the socket of the connection is readable.
+    virtual bool executeStatementNonBlocking(DatabaseConnection &databaseConnection, MYSQL *m_sql,
+                                             const std::shared_ptr<IQueryData> &data) {
+        executeStatement(databaseConnection, m_sql, data);
+        return true;
+    }
 
     //Wrapper functions for c api that throw exceptions
     static void mysqlQuery(MYSQL *sql, std::string &query);
 
     static MYSQL_RES *mysqlStoreResults(MYSQL *sql);
 
+    static MYSQL_RES *mysqlUseResults(MYSQL *sql);
+
     static bool mysqlNextResult(MYSQL *sql);
 
     //fields
     std::shared_ptr<Database> m_database{};
     int m_options = 0;
+    std::atomic<QueryPriority> m_priority{PRIORITY_NORMAL};
+    std::chrono::milliseconds m_maxQueueTime{0}; //0 means the max queue time of the database is used
     std::deque<std::shared_ptr<IQueryData>> runningQueryData;
     bool hasBeenStarted = false;
 };
@@ -154,11 +198,25 @@ public:
     bool isFirstData() const {
         return m_wasFirstData;
     }
+
+    void setQueueDeadline(std::chrono::steady_clock::time_point deadline) {
+        m_queueDeadline = deadline;
+    }
+
+    bool hasQueueDeadlinePassed() const {
+        return std::chrono::steady_clock::now() > m_queueDeadline;
+    }
+
+    //Whether the query may be executed again after its connection was lost
+    virtual bool canRetry() const {
+        return true;
+    }
     int m_successReference = 0;
     int m_errorReference = 0;
     int m_abortReference = 0;
     int m_onDataReference = 0;
     int m_tableReference = 0;
+    int m_coroutineReference = 0; //Coroutine that awaits the query, it is resumed instead of running the callbacks
 
     virtual void finishLuaQueryData(GarrysMod::Lua::ILuaBase *LUA, const std::shared_ptr<IQuery> &query);
 protected:
@@ -167,6 +225,8 @@ protected:
     std::atomic<QueryStatus> m_status{QUERY_NOT_RUNNING};
     std::atomic<QueryResultStatus> m_resultStatus{QUERY_NONE};
     bool m_wasFirstData = false;
+    //Set before the query is queued, the query is not run anymore if it is taken from the queue afterwards
+    std::chrono::steady_clock::time_point m_queueDeadline = std::chrono::steady_clock::time_point::max();
 };
 
 #endif
\ No newline at end of file
@@ -15,6 +15,6 @@ PingQuery::~PingQuery() = default;
 
 /* Executes the ping query
 */
-void PingQuery::executeStatement(Database &database, MYSQL *connection, const std::shared_ptr<IQueryData> &data) {
-    this->pingSuccess = mysql_ping(connection) == 0 || database.attemptReconnect();
+void PingQuery::executeStatement(DatabaseConnection &databaseConnection, MYSQL *connection, const std::shared_ptr<IQueryData> &data) {
+    this->pingSuccess = mysql_ping(connection) == 0 || databaseConnection.attemptReconnect();
 }
\ No newline at end of file
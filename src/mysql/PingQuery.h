@@ -20,7 +20,11 @@ protected:
 
     std::string getSQLString() override { return ""; };
 
-    void executeStatement(Database &database, MYSQL *m_sql, const std::shared_ptr<IQueryData> &data) override;
+    bool hasLuaCorrespondence() const override { return false; }
+
+    void executeStatement(DatabaseConnection &databaseConnection, MYSQL *m_sql, const std::shared_ptr<IQueryData> &data) override;
+
+    bool canRunNonBlocking(const IQueryData &data) const override { return false; }
 
     bool pingSuccess = false;
 };
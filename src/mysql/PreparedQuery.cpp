@@ -1,9 +1,10 @@
 #include "PreparedQuery.h"
 
 #include <memory>
-#include <sstream>
 #include "Database.h"
 #include <cstring>
+#include <cctype>
+#include <algorithm>
 #include "mysql/errmsg.h"
 #include "mysql/mysqld_error.h"
 #include "MySQLOOException.h"
@@ -12,14 +13,77 @@
 #include <stdlib.h>
 #endif
 
-PreparedQuery::PreparedQuery(const std::shared_ptr<Database> &dbase, std::string query) : Query(dbase,
-                                                                                                std::move(query)) {
-    putNewParameters();
+//Builds a statement that selects the inserted columns without reading any rows, e.g.
+//"INSERT INTO t (a, b) VALUES " results in "SELECT a, b FROM t LIMIT 0" and "INSERT INTO t VALUES " in "SELECT * FROM t LIMIT 0"
+static bool buildColumnProbe(const std::string &query, size_t targetStart, size_t targetEnd, std::string &probe) {
+    const char *whitespace = " \t\r\n";
+    size_t first = query.find_first_not_of(whitespace, targetStart);
+    size_t last = query.find_last_not_of(whitespace, targetEnd - 1);
+    if (first == std::string::npos || last == std::string::npos || last < first) return false;
+    std::string columns = "*";
+    if (query[last] == ')') {
+        int depth = 0;
+        size_t open = last;
+        for (; open > first; open--) {
+            if (query[open] == ')') depth++;
+            if (query[open] == '(' && --depth == 0) break;
+        }
+        if (open == first) return false;
+        columns = query.substr(open + 1, last - open - 1);
+        last = query.find_last_not_of(whitespace, open - 1);
+        if (last == std::string::npos || last < first) return false;
+    }
+    probe = "SELECT " + columns + " FROM " + query.substr(first, last - first + 1) + " LIMIT 0";
+    return true;
 }
 
+//Splits a single row insert into the part up to VALUES and the row, returns false for any other statement
+//Only simple statements are accepted, so repeating the row can't change the meaning of the statement
+static bool splitSingleRowInsert(const std::string &query, std::string &prefix, std::string &row,
+                                 std::string &columnProbe) {
+    const char *whitespace = " \t\r\n";
+    std::string upper(query.size(), ' ');
+    std::transform(query.begin(), query.end(), upper.begin(), [](unsigned char c) { return (char) std::toupper(c); });
+    //String literals, comments and multiple statements could contain anything, these are never merged
+    if (upper.find_first_of("'\"#;") != std::string::npos || upper.find("--") != std::string::npos ||
+        upper.find("/*") != std::string::npos) {
+        return false;
+    }
+    //Modifiers like IGNORE change how many rows are affected, so INTO has to directly follow INSERT
+    size_t start = upper.find_first_not_of(whitespace);
+    if (start == std::string::npos || upper.compare(start, 6, "INSERT") != 0) return false;
+    size_t into = upper.find_first_not_of(whitespace, start + 6);
+    if (into == std::string::npos || into == start + 6 || upper.compare(into, 4, "INTO") != 0) return false;
+    size_t values = upper.find("VALUES");
+    if (values == std::string::npos || upper.find("VALUES", values + 1) != std::string::npos) return false;
+    if (!std::isspace((unsigned char) upper[values - 1]) && upper[values - 1] != ')') return false;
+    size_t rowStart = upper.find_first_not_of(whitespace, values + 6);
+    size_t rowEnd = upper.find_last_not_of(whitespace);
+    if (rowStart == std::string::npos || upper[rowStart] != '(' || upper[rowEnd] != ')') return false;
+    //The row has to be a single group of values that ends the statement (no ON DUPLICATE KEY UPDATE)
+    int depth = 0;
+    for (size_t i = rowStart; i <= rowEnd; i++) {
+        if (upper[i] == '(') {
+            depth++;
+        } else if (upper[i] == ')') {
+            depth--;
+            if (depth == 0 && i != rowEnd) return false;
+        }
+    }
+    //All parameters have to be part of the row
+    if (depth != 0 || std::count(upper.begin(), upper.begin() + (long) rowStart, '?') != 0) return false;
+    if (!buildColumnProbe(query, into + 4, values, columnProbe)) return false;
+    prefix = query.substr(0, rowStart);
+    row = query.substr(rowStart, rowEnd - rowStart + 1);
+    return true;
+}
 
-PreparedQuery::~PreparedQuery() {
-    m_database->freeStatement(cachedStatement);
+PreparedQuery::PreparedQuery(const std::shared_ptr<Database> &dbase, std::string query) : Query(dbase,
+                                                                                                std::move(query)) {
+    putNewParameters();
+    if (splitSingleRowInsert(m_query, m_coalescePrefix, m_coalesceRow, m_coalesceColumnProbe)) {
+        m_coalesceParameterCount = (unsigned int) std::count(m_coalesceRow.begin(), m_coalesceRow.end(), '?');
+    }
 }
 
 
@@ -28,35 +92,34 @@ void PreparedQuery::clearParameters() {
     m_parameters.emplace_back();
 }
 
-void PreparedQuery::setNumber(unsigned int index, double value) {
+//Parameter indices are checked here, so the parameter sets can't grow beyond what a statement can use
+static void checkParameterIndex(unsigned int index) {
     if (index < 1) {
         throw MySQLOOException("Index must be greater than 0");
     }
-    m_parameters.back()[index] = std::shared_ptr<PreparedQueryField>(
-            new TypedQueryField<double>(index, MYSQL_TYPE_DOUBLE, value));
+    if (index > PreparedQuery::MAX_STATEMENT_PARAMETERS) {
+        throw MySQLOOException("Index must not be greater than 65535");
+    }
 }
 
-void PreparedQuery::setString(unsigned int index, const std::string &value) {
-    if (index < 1) {
-        throw MySQLOOException("Index must be greater than 0");
-    }
-    m_parameters.back()[index] = std::shared_ptr<PreparedQueryField>(
-            new TypedQueryField<std::string>(index, MYSQL_TYPE_STRING, value));
+void PreparedQuery::setNumber(unsigned int index, double value) {
+    checkParameterIndex(index);
+    m_parameters.back().setNumber(index, value);
+}
+
+void PreparedQuery::setString(unsigned int index, const char *value, size_t length) {
+    checkParameterIndex(index);
+    m_parameters.back().setString(index, value, length);
 }
 
 void PreparedQuery::setBoolean(unsigned int index, bool value) {
-    if (index < 1) {
-        throw MySQLOOException("Index must be greater than 0");
-    }
-    m_parameters.back()[index] = std::shared_ptr<PreparedQueryField>(
-            new TypedQueryField<bool>(index, MYSQL_TYPE_BIT, value));
+    checkParameterIndex(index);
+    m_parameters.back().setBoolean(index, value);
 }
 
 void PreparedQuery::setNull(unsigned int index) {
-    if (index < 1) {
-        throw MySQLOOException("Index must be greater than 0");
-    }
-    m_parameters.back()[index] = std::make_shared<PreparedQueryField>(index, MYSQL_TYPE_NULL);
+    checkParameterIndex(index);
+    m_parameters.back().setNull(index);
 }
 
 //Adds an additional set of parameters to the prepared query
@@ -65,6 +128,15 @@ void PreparedQuery::putNewParameters() {
     m_parameters.emplace_back();
 }
 
+//Only clears the parameter set that is currently being filled, previously put sets are kept
+void PreparedQuery::clearCurrentParameters() {
+    m_parameters.back().clear();
+}
+
+bool PreparedQuery::hasCurrentParameters() const {
+    return !m_parameters.back().empty();
+}
+
 //Wrapper functions that might throw errors
 MYSQL_STMT *PreparedQuery::mysqlStmtInit(MYSQL *sql) {
     MYSQL_STMT *stmt = mysql_stmt_init(sql);
@@ -127,45 +199,40 @@ static unsigned int trueValue = 1;
 static unsigned int falseValue = 0;
 
 //Generates binds for a prepared query. In this case the binds are used to send the parameters to the server
-void PreparedQuery::generateMysqlBinds(MYSQL_BIND *binds,
-                                       std::unordered_map<unsigned int, std::shared_ptr<PreparedQueryField>> &map,
+//Parameters that aren't set are sent as NULL, setting a parameter with an index greater than parameterCount is an error
+void PreparedQuery::generateMysqlBinds(MYSQL_BIND *binds, PreparedQueryParameters &parameters,
                                        unsigned int parameterCount) {
-    for (unsigned int i = 1; i <= parameterCount; i++) {
-        auto it = map.find(i);
-        if (it == map.end()) {
-            MYSQL_BIND *bind = &binds[i - 1];
-            bind->buffer_type = MYSQL_TYPE_NULL;
-            bind->is_null = &nullBool;
-            continue;
-        }
-        unsigned int index = it->second->m_index - 1;
-        if (index >= parameterCount) {
-            std::stringstream errStream;
-            errStream << "Invalid parameter index " << index + 1;
-            throw MySQLException(0, errStream.str().c_str());
-        }
-        MYSQL_BIND *bind = &binds[index];
-        switch (it->second->m_type) {
-            case MYSQL_TYPE_DOUBLE: {
-                auto *doubleField = dynamic_cast<TypedQueryField<double> *>(it->second.get());
+    auto &fields = parameters.getFields();
+    for (size_t i = parameterCount; i < fields.size(); i++) {
+        if (fields[i].type != PreparedQueryField::TYPE_UNSET) {
+            std::string error = "Invalid parameter index " + std::to_string(i + 1);
+            throw MySQLException(0, error.c_str());
+        }
+    }
+    for (unsigned int i = 0; i < parameterCount; i++) {
+        MYSQL_BIND *bind = &binds[i];
+        //The binds are reused for every parameter set, so nothing of the previous set may be left over
+        std::memset(bind, 0, sizeof(MYSQL_BIND));
+        auto type = (i < fields.size()) ? fields[i].type : PreparedQueryField::TYPE_UNSET;
+        switch (type) {
+            case PreparedQueryField::TYPE_NUMBER: {
                 bind->buffer_type = MYSQL_TYPE_DOUBLE;
-                bind->buffer = (char *) &doubleField->m_data;
+                bind->buffer = (char *) &fields[i].number;
                 break;
             }
-            case MYSQL_TYPE_BIT: {
-                auto *boolField = dynamic_cast<TypedQueryField<bool> *>(it->second.get());
+            case PreparedQueryField::TYPE_BOOLEAN: {
                 bind->buffer_type = MYSQL_TYPE_LONG;
-                bind->buffer = (char *) &((boolField->m_data) ? trueValue : falseValue);
+                bind->buffer = (char *) &((fields[i].boolean) ? trueValue : falseValue);
                 break;
             }
-            case MYSQL_TYPE_STRING: {
-                auto *textField = dynamic_cast<TypedQueryField<std::string> *>(it->second.get());
+            case PreparedQueryField::TYPE_STRING: {
                 bind->buffer_type = MYSQL_TYPE_STRING;
-                bind->buffer = (char *) textField->m_data.c_str();
-                bind->buffer_length = (unsigned long) textField->m_data.length();
+                bind->buffer = parameters.getString(fields[i]);
+                bind->buffer_length = (unsigned long) fields[i].string.length;
                 break;
             }
-            case MYSQL_TYPE_NULL: {
+            case PreparedQueryField::TYPE_UNSET:
+            case PreparedQueryField::TYPE_NULL: {
                 bind->buffer_type = MYSQL_TYPE_NULL;
                 bind->is_null = &nullBool;
                 break;
@@ -177,30 +244,47 @@ void PreparedQuery::generateMysqlBinds(MYSQL_BIND *binds,
 /* Executes the prepared query
 * This function can only ever return one result set
 * Note: If an error occurs at the nth query all the actions done before
-* that nth query won't be reverted even though this query results in an error
+* that nth query won't be reverted even though this query results in an error.
+* With bulk inserts enabled, the parameter sets of a single row insert are sent as multi row inserts instead,
+* an error then reverts all rows of the multi row insert it occurred in.
 */
-void PreparedQuery::executeStatement(Database &database, MYSQL *connection, const std::shared_ptr<IQueryData>& ptr) {
-    std::shared_ptr<PreparedQueryData> data = std::dynamic_pointer_cast<PreparedQueryData>(ptr);
+void PreparedQuery::executeStatement(DatabaseConnection &databaseConnection, MYSQL *connection, const std::shared_ptr<IQueryData>& ptr) {
+    auto *data = dynamic_cast<PreparedQueryData *>(ptr.get());
     try {
+        //Batches of a single row insert are sent as multi row inserts, which saves a round trip per row
+        if (data->m_parameters.size() > 1 && !m_coalesceRow.empty() && !data->shouldStreamResults() &&
+            databaseConnection.getDatabase().shouldBulkInsert() && insertsGeneratedIdsOnly(databaseConnection)) {
+            executeBulkInsert(databaseConnection, connection, *data);
+            return;
+        }
+        const bool shouldCache = databaseConnection.getDatabase().shouldCachePreparedStatements();
         MYSQL_STMT *stmt = nullptr;
+        bool isCached = false;
         auto stmtClose = finally([&] {
-            if (!database.shouldCachePreparedStatements() && stmt != nullptr) {
+            if (!isCached && stmt != nullptr) {
                 mysql_stmt_close(stmt);
             }
         });
-        if (this->cachedStatement != nullptr && this->cachedStatement->isValid()) {
-            stmt = this->cachedStatement->stmt;
+        auto cachedStatement = shouldCache ? databaseConnection.getCachedStatement(m_query) : nullptr;
+        if (cachedStatement != nullptr && cachedStatement->isValid()) {
+            stmt = cachedStatement->stmt;
+            isCached = true;
         } else {
             stmt = mysqlStmtInit(connection);
             const bool attrMaxLength = true;
             mysql_stmt_attr_set(stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &attrMaxLength);
             mysqlStmtPrepare(stmt, this->m_query.c_str());
-            if (database.shouldCachePreparedStatements()) {
-                this->cachedStatement = database.cacheStatement(stmt);
+            if (shouldCache) {
+                cachedStatement = databaseConnection.cacheStatement(m_query, stmt);
+                isCached = true;
             }
         }
+        //Statements that are not cached only use their buffers once
+        StatementBuffers uncachedBuffers;
+        StatementBuffers &buffers = isCached ? cachedStatement->buffers : uncachedBuffers;
         unsigned int parameterCount = mysql_stmt_param_count(stmt);
-        std::vector<MYSQL_BIND> mysqlParameters(parameterCount);
+        std::vector<MYSQL_BIND> &mysqlParameters = buffers.parameterBinds;
+        mysqlParameters.resize(parameterCount);
 
         for (auto &currentMap: data->m_parameters) {
             generateMysqlBinds(mysqlParameters.data(), currentMap, parameterCount);
@@ -218,35 +302,274 @@ void PreparedQuery::executeStatement(Database &database, MYSQL *connection, cons
                     //Add an empty ResultData in that case
                     //This is only necessary due to MariaDB client behaving differently to the Mysql client
                     //otherwise we get a hang in the rest of the code below
-                    data->m_results.emplace_back();
+                    data->m_results.push_back(ResultData::empty());
                     continue;
                 }
                 auto f = finally([&] { mysql_free_result(metaData); });
+                if (data->shouldStreamResults()) {
+                    auto f2 = finally([&] { mysql_stmt_free_result(stmt); });
+                    streamStatementResults(databaseConnection, stmt, metaData, buffers, ptr);
+                    //The rows have already been passed on, the callbacks receive an empty result set
+                    data->m_results.push_back(ResultData::empty());
+                    continue;
+                }
                 //There is a potential race condition here. What happens
                 //when the query executes fine but something goes wrong while storing the result?
                 mysqlStmtStoreResult(stmt);
                 auto f2 = finally([&] { mysql_stmt_free_result(stmt); });
-                data->m_results.emplace_back(stmt, metaData);
+                data->m_results.push_back(std::make_shared<ResultData>(stmt, metaData, buffers));
             } while (mysqlStmtNextResult(stmt));
         }
     } catch (const MySQLException &error) {
         const unsigned int errorCode = error.getErrorCode();
         if (Database::isRetriableError(errorCode)) {
             //In this case the statement will no longer be valid, free it.
-            database.freeStatement(this->cachedStatement);
+            databaseConnection.evictStatement(m_query);
         }
         throw error;
     }
 }
 
+//Fetches the rows of an executed statement from the server in chunks without storing the whole result first
+//Each chunk is passed to the main thread as soon as it has been fetched, so it can be passed to onData
+void PreparedQuery::streamStatementResults(DatabaseConnection &databaseConnection, MYSQL_STMT *stmt,
+                                           MYSQL_RES *metaData, StatementBuffers &buffers,
+                                           const std::shared_ptr<IQueryData> &data) {
+    while (true) {
+        ResultData chunk(stmt, metaData, buffers, STREAM_CHUNK_SIZE);
+        const size_t rowCount = chunk.getRowCount();
+        if (rowCount > 0) {
+            databaseConnection.getDatabase().putStreamedResult(std::make_pair(shared_from_this(), data),
+                                                               std::move(chunk));
+        }
+        if (rowCount < STREAM_CHUNK_SIZE) {
+            return;
+        }
+    }
+}
+
+//Whether this execution of the query can be merged with other queued executions of the same single row insert
+bool PreparedQuery::canCoalesce(const IQueryData &data) const {
+    if (m_coalesceRow.empty()) return false;
+    auto &queryData = dynamic_cast<const PreparedQueryData &>(data);
+    //Invalid parameter indices are reported by running the query on its own, so they don't fail the other queries
+    return queryData.m_parameters.size() == 1 && !queryData.shouldStreamResults() &&
+           queryData.m_parameters.front().getFields().size() <= m_coalesceParameterCount;
+}
+
+/* The insert ids of a multi row insert are only known if the server generates all of them.
+ * Rows that set the AUTO_INCREMENT column themselves don't take a generated id, so statements that name it are never merged.
+ */
+bool PreparedQuery::insertsGeneratedIdsOnly(DatabaseConnection &databaseConnection) const {
+    return !databaseConnection.selectsAutoIncrementColumn(m_coalesceColumnProbe);
+}
+
+size_t PreparedQuery::estimateCoalescedRowSize(const IQueryData &data) const {
+    auto &queryData = dynamic_cast<const PreparedQueryData &>(data);
+    return estimateInsertRowSize(queryData.m_parameters.front());
+}
+
+//Upper bound of the amount of bytes a row adds to the statement and the packet that executes it
+size_t PreparedQuery::estimateInsertRowSize(
+        const PreparedQueryParameters &parameters) const {
+    //Separator, parameter types and the null bitmap
+    size_t size = m_coalesceRow.size() + 2 + m_coalesceParameterCount * 3;
+    for (auto &field: parameters.getFields()) {
+        if (field.type == PreparedQueryField::TYPE_STRING) {
+            size += field.string.length + 9;
+        } else {
+            size += 8;
+        }
+    }
+    return size;
+}
+
+//Whether a multi row insert with this many rows and this estimated size is accepted by the server
+bool PreparedQuery::fitsIntoInsert(size_t rowCount, size_t statementSize, unsigned long long maxAllowedPacket) const {
+    //Some room is left for the packet headers
+    return rowCount <= MAX_INSERT_ROWS && rowCount * m_coalesceParameterCount <= MAX_STATEMENT_PARAMETERS &&
+           statementSize + 1024 <= maxAllowedPacket;
+}
+
+//The sql of a multi row insert of this single row insert with the given amount of rows
+std::string PreparedQuery::buildMultiRowInsert(size_t rowCount) const {
+    std::string sql = m_coalescePrefix;
+    sql.reserve(sql.size() + rowCount * (m_coalesceRow.size() + 2));
+    for (size_t i = 0; i < rowCount; i++) {
+        if (i > 0) {
+            sql += ", ";
+        }
+        sql += m_coalesceRow;
+    }
+    return sql;
+}
+
+/* Prepares the multi row insert with the given amount of rows (see buildMultiRowInsert).
+ * The statement is cached like the statements of prepared queries, isCached is false if the caller has to close it.
+ */
+std::shared_ptr<StatementHandle> PreparedQuery::prepareMultiRowInsert(DatabaseConnection &databaseConnection,
+                                                                      MYSQL *connection, size_t rowCount,
+                                                                      bool &isCached) {
+    const std::string sql = buildMultiRowInsert(rowCount);
+    const bool shouldCache = databaseConnection.getDatabase().shouldCachePreparedStatements();
+    auto cachedStatement = shouldCache ? databaseConnection.getCachedStatement(sql) : nullptr;
+    if (cachedStatement != nullptr && cachedStatement->isValid()) {
+        isCached = true;
+        return cachedStatement;
+    }
+    MYSQL_STMT *stmt = mysqlStmtInit(connection);
+    try {
+        mysqlStmtPrepare(stmt, sql.c_str());
+    } catch (const MySQLException &) {
+        mysql_stmt_close(stmt);
+        throw;
+    }
+    isCached = shouldCache;
+    if (shouldCache) {
+        return databaseConnection.cacheStatement(sql, stmt);
+    }
+    return std::make_shared<StatementHandle>(stmt, true);
+}
+
+/* Inserts all rows with a prepared multi row insert (see prepareMultiRowInsert) and returns the insert id of each row.
+ * On tables that don't support transactions, the rows before a failing row stay inserted.
+ * The server generates consecutive ids for the rows, so this is only correct if none of them sets its id itself.
+ */
+std::vector<my_ulonglong> PreparedQuery::executeMultiRowInsert(DatabaseConnection &databaseConnection,
+                                                               StatementHandle &statement,
+                                                               const std::vector<PreparedQueryParameters *> &rows) {
+    MYSQL_STMT *stmt = statement.stmt;
+    const unsigned int parameterCount = m_coalesceParameterCount;
+    std::vector<MYSQL_BIND> &mysqlParameters = statement.buffers.parameterBinds;
+    mysqlParameters.resize(rows.size() * parameterCount);
+    for (size_t i = 0; i < rows.size(); i++) {
+        generateMysqlBinds(mysqlParameters.data() + i * parameterCount, *rows[i], parameterCount);
+    }
+    if (mysql_stmt_param_count(stmt) != mysqlParameters.size()) {
+        throw MySQLException(0, "Unexpected parameter count of multi row insert");
+    }
+    mysqlStmtBindParameter(stmt, mysqlParameters.data());
+    try {
+        mysqlStmtExecute(stmt);
+    } catch (const MySQLException &error) {
+        if (Database::isRetriableError(error.getErrorCode())) {
+            //In this case the statement will no longer be valid, free it.
+            databaseConnection.evictStatement(buildMultiRowInsert(rows.size()));
+        }
+        throw;
+    }
+    const my_ulonglong firstInsertId = mysql_stmt_insert_id(stmt);
+    std::vector<my_ulonglong> insertIds(rows.size(), firstInsertId);
+    if (firstInsertId != 0 && rows.size() > 1) {
+        const unsigned long long increment = databaseConnection.getAutoIncrementIncrement();
+        for (size_t i = 1; i < rows.size(); i++) {
+            insertIds[i] = firstInsertId + i * increment;
+        }
+    }
+    return insertIds;
+}
+
+/* Runs the queued executions of this single row insert as a single multi row insert and passes the
+ * affected rows and insert ids on to each of them. The queries of the batch all have the same sql as this query.
+ * Returns false if the server rejected the insert without inserting any row, the queries can then be run one by one:
+ * If the statement can't be prepared, or if a row is a duplicate and the transaction the insert runs in was rolled back
+ * completely (the server warns if a table doesn't support transactions).
+ * Any other error is thrown, since rows might have been inserted (e.g. the connection was lost after the insert).
+ */
+bool PreparedQuery::executeCoalescedInserts(DatabaseConnection &databaseConnection, MYSQL *connection,
+                                            const std::vector<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> &batch) {
+    std::vector<PreparedQueryParameters *> rows;
+    rows.reserve(batch.size());
+    for (auto &pair: batch) {
+        rows.push_back(&dynamic_cast<PreparedQueryData *>(pair.second.get())->m_parameters.front());
+    }
+    std::shared_ptr<StatementHandle> statement;
+    bool isCached = false;
+    auto stmtClose = finally([&] {
+        if (!isCached && statement != nullptr) {
+            mysql_stmt_close(statement->stmt);
+        }
+    });
+    std::string startTransaction = "START TRANSACTION";
+    try {
+        statement = prepareMultiRowInsert(databaseConnection, connection, rows.size(), isCached);
+        mysqlQuery(connection, startTransaction);
+    } catch (const MySQLException &) {
+        return false;
+    }
+    std::vector<my_ulonglong> insertIds;
+    try {
+        insertIds = executeMultiRowInsert(databaseConnection, *statement, rows);
+    } catch (const MySQLException &error) {
+        const bool rolledBack = mysql_rollback(connection) == 0 && mysql_warning_count(connection) == 0;
+        if (rolledBack && error.getErrorCode() == ER_DUP_ENTRY) {
+            return false;
+        }
+        throw;
+    }
+    if (mysql_commit(connection)) {
+        throw MySQLException(mysql_errno(connection), mysql_error(connection));
+    }
+    for (size_t i = 0; i < batch.size(); i++) {
+        auto *data = dynamic_cast<PreparedQueryData *>(batch[i].second.get());
+        data->m_affectedRows.push_back(1);
+        data->m_insertIds.push_back(insertIds[i]);
+        data->m_results.push_back(ResultData::empty());
+        data->m_resultStatus = QUERY_SUCCESS;
+    }
+    return true;
+}
+
+/* Runs all parameter sets of a single row insert with as few multi row inserts as the server limits allow,
+ * instead of executing the statement once per parameter set.
+ * Each parameter set still gets its own result, just like if they had been executed one by one.
+ */
+void PreparedQuery::executeBulkInsert(DatabaseConnection &databaseConnection, MYSQL *connection, PreparedQueryData &data) {
+    const unsigned long long maxAllowedPacket = databaseConnection.getMaxAllowedPacket();
+    std::vector<PreparedQueryParameters *> rows;
+    size_t statementSize = m_coalescePrefix.size();
+    auto insertRows = [&] {
+        bool isCached = false;
+        auto statement = prepareMultiRowInsert(databaseConnection, connection, rows.size(), isCached);
+        auto stmtClose = finally([&] {
+            if (!isCached) {
+                mysql_stmt_close(statement->stmt);
+            }
+        });
+        const std::vector<my_ulonglong> insertIds = executeMultiRowInsert(databaseConnection, *statement, rows);
+        for (size_t i = 0; i < rows.size(); i++) {
+            data.m_affectedRows.push_back(1);
+            data.m_insertIds.push_back(insertIds[i]);
+            data.m_results.push_back(ResultData::empty());
+        }
+        data.m_resultStatus = QUERY_SUCCESS;
+        rows.clear();
+        statementSize = m_coalescePrefix.size();
+    };
+    for (auto &parameters: data.m_parameters) {
+        size_t rowSize = estimateInsertRowSize(parameters);
+        if (!rows.empty() && !fitsIntoInsert(rows.size() + 1, statementSize + rowSize, maxAllowedPacket)) {
+            insertRows();
+        }
+        rows.push_back(&parameters);
+        statementSize += rowSize;
+    }
+    if (!rows.empty()) {
+        insertRows();
+    }
+}
+
 std::shared_ptr<QueryData> PreparedQuery::buildQueryData() {
     std::shared_ptr<PreparedQueryData> data(new PreparedQueryData());
-    data->m_parameters = this->m_parameters;
-    while (m_parameters.size() > 1) {
-        //Front so the last used parameters are the ones that are gonna stay
-        m_parameters.pop_front();
+    data->m_parameters = std::move(this->m_parameters);
+    this->m_parameters.clear();
+    //The last used parameters are the ones that are gonna stay
+    if (data->m_parameters.empty()) {
+        this->m_parameters.emplace_back();
+    } else {
+        this->m_parameters.push_back(data->m_parameters.back());
     }
-    return std::dynamic_pointer_cast<QueryData>(data);
+    return data;
 }
 
 std::shared_ptr<PreparedQuery> PreparedQuery::create(const std::shared_ptr<Database> &dbase, std::string query) {
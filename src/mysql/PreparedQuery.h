@@ -1,44 +1,108 @@
 #ifndef PREPAREDQUERY_
 #define PREPAREDQUERY_
 
-#include <unordered_map>
+#include <vector>
+#include <mutex>
 #include "Query.h"
-#include "StatementHandle.h"
 
-class PreparedQueryField {
-    friend class PreparedQuery;
-
-public:
-    PreparedQueryField(unsigned int index, int type) : m_index(index), m_type(type) {}
-
-    PreparedQueryField() : m_index(1), m_type(0) {}
-
-    virtual ~PreparedQueryField() = default;
-
-private:
-    unsigned int m_index;
-    int m_type;
+/* A single parameter of a prepared query.
+ * The value of a string is stored in the buffer of the PreparedQueryParameters the field belongs to.
+ */
+struct PreparedQueryField {
+    enum Type : unsigned char {
+        TYPE_UNSET = 0, //Sent as NULL
+        TYPE_NUMBER,
+        TYPE_STRING,
+        TYPE_BOOLEAN,
+        TYPE_NULL
+    };
+    Type type = TYPE_UNSET;
+    union {
+        double number = 0;
+        bool boolean;
+        struct {
+            size_t offset;
+            size_t length;
+            size_t capacity; //Space reserved for the string in the buffer
+        } string;
+    };
 };
 
-template<typename T>
-class TypedQueryField : public PreparedQueryField {
-    friend class PreparedQuery;
-
+/* One set of parameters of a prepared query, the field of parameter n is stored at n - 1.
+ * All strings share a single buffer, so setting parameters doesn't allocate once the buffers are large enough.
+ */
+class PreparedQueryParameters {
 public:
-    TypedQueryField(unsigned int index, int type, const T &data)
-            : PreparedQueryField(index, type), m_data(data) {};
-
-    ~TypedQueryField() override = default;
+    void setNumber(unsigned int index, double value) {
+        auto &field = getField(index);
+        field.type = PreparedQueryField::TYPE_NUMBER;
+        field.number = value;
+    }
+
+    void setString(unsigned int index, const char *value, size_t length) {
+        auto &field = getField(index);
+        //Overwriting a string with one that fits reuses its space, so setting the same parameter again doesn't grow the buffer
+        if (field.type == PreparedQueryField::TYPE_STRING && length <= field.string.capacity) {
+            stringBuffer.replace(field.string.offset, length, value, length);
+            field.string.length = length;
+            return;
+        }
+        field.type = PreparedQueryField::TYPE_STRING;
+        field.string.offset = stringBuffer.size();
+        field.string.length = length;
+        field.string.capacity = length;
+        stringBuffer.append(value, length);
+    }
+
+    void setBoolean(unsigned int index, bool value) {
+        auto &field = getField(index);
+        field.type = PreparedQueryField::TYPE_BOOLEAN;
+        field.boolean = value;
+    }
+
+    void setNull(unsigned int index) {
+        getField(index).type = PreparedQueryField::TYPE_NULL;
+    }
+
+    //Keeps the capacity of the buffers
+    void clear() {
+        fields.clear();
+        stringBuffer.clear();
+    }
+
+    bool empty() const {
+        return fields.empty();
+    }
+
+    std::vector<PreparedQueryField> &getFields() {
+        return fields;
+    }
+
+    const std::vector<PreparedQueryField> &getFields() const {
+        return fields;
+    }
+
+    char *getString(const PreparedQueryField &field) {
+        return stringBuffer.data() + field.string.offset;
+    }
 
 private:
-    T m_data;
+    PreparedQueryField &getField(unsigned int index) {
+        if (index > fields.size()) {
+            fields.resize(index);
+        }
+        return fields[index - 1];
+    }
+
+    std::vector<PreparedQueryField> fields{};
+    std::string stringBuffer{};
 };
 
 class PreparedQueryData : public QueryData {
     friend class PreparedQuery;
 
 protected:
-    std::deque<std::unordered_map<unsigned int, std::shared_ptr<PreparedQueryField>>> m_parameters;
+    std::deque<PreparedQueryParameters> m_parameters;
     bool firstAttempt = true;
 
     PreparedQueryData() = default;
@@ -48,15 +112,16 @@ class PreparedQuery : public Query {
     friend class Database;
 
 public:
-    ~PreparedQuery() override;
+    void executeStatement(DatabaseConnection &databaseConnection, MYSQL *connection, const std::shared_ptr<IQueryData> &data) override;
 
-    void executeStatement(Database &database, MYSQL *connection, const std::shared_ptr<IQueryData> &data) override;
+    //There is no non blocking api for prepared statements
+    bool canRunNonBlocking(const IQueryData &data) const override { return false; }
 
     void clearParameters();
 
     void setNumber(unsigned int index, double value);
 
-    void setString(unsigned int index, const std::string &value);
+    void setString(unsigned int index, const char *value, size_t length);
 
     void setBoolean(unsigned int index, bool value);
 
@@ -64,20 +129,27 @@ public:
 
     void putNewParameters();
 
+    void clearCurrentParameters();
+
+    bool hasCurrentParameters() const;
+
     std::shared_ptr<QueryData> buildQueryData() override;
 
     static std::shared_ptr<PreparedQuery> create(const std::shared_ptr<Database> &dbase, std::string query);
 
+    //Maximum amount of rows that are inserted by a single multi row insert
+    static constexpr size_t MAX_INSERT_ROWS = 1000;
+    //The server doesn't accept statements with more placeholders than this
+    static constexpr size_t MAX_STATEMENT_PARAMETERS = 65535;
+
 private:
     PreparedQuery(const std::shared_ptr<Database> &dbase, std::string query);
 
-    std::deque<std::unordered_map<unsigned int, std::shared_ptr<PreparedQueryField>>> m_parameters{};
+    std::deque<PreparedQueryParameters> m_parameters{};
 
     static MYSQL_STMT *mysqlStmtInit(MYSQL *sql);
 
-    static void
-    generateMysqlBinds(MYSQL_BIND *binds, std::unordered_map<unsigned int, std::shared_ptr<PreparedQueryField>> &map,
-                       unsigned int parameterCount);
+    static void generateMysqlBinds(MYSQL_BIND *binds, PreparedQueryParameters &parameters, unsigned int parameterCount);
 
     static void mysqlStmtBindParameter(MYSQL_STMT *sql, MYSQL_BIND *bind);
 
@@ -89,7 +161,39 @@ private:
 
     static bool mysqlStmtNextResult(MYSQL_STMT *sql);
 
-    std::shared_ptr<StatementHandle> cachedStatement{nullptr};
+    void streamStatementResults(DatabaseConnection &databaseConnection, MYSQL_STMT *stmt, MYSQL_RES *metaData,
+                                StatementBuffers &buffers, const std::shared_ptr<IQueryData> &data);
+
+    bool canCoalesce(const IQueryData &data) const;
+
+    bool insertsGeneratedIdsOnly(DatabaseConnection &databaseConnection) const;
+
+    size_t estimateCoalescedRowSize(const IQueryData &data) const;
+
+    size_t estimateInsertRowSize(const PreparedQueryParameters &parameters) const;
+
+    bool fitsIntoInsert(size_t rowCount, size_t statementSize, unsigned long long maxAllowedPacket) const;
+
+    std::string buildMultiRowInsert(size_t rowCount) const;
+
+    std::shared_ptr<StatementHandle> prepareMultiRowInsert(DatabaseConnection &databaseConnection, MYSQL *connection,
+                                                           size_t rowCount, bool &isCached);
+
+    std::vector<my_ulonglong> executeMultiRowInsert(DatabaseConnection &databaseConnection, StatementHandle &statement,
+                                                    const std::vector<PreparedQueryParameters *> &rows);
+
+    bool executeCoalescedInserts(DatabaseConnection &databaseConnection, MYSQL *connection,
+                                 const std::vector<std::pair<std::shared_ptr<IQuery>, std::shared_ptr<IQueryData>>> &batch);
+
+    void executeBulkInsert(DatabaseConnection &databaseConnection, MYSQL *connection, PreparedQueryData &data);
+
+    //Set if the query is a single row insert, e.g. "INSERT INTO t (a, b) VALUES (?, ?)" is split into
+    //"INSERT INTO t (a, b) VALUES " and "(?, ?)", so several executions can be merged into a multi row insert
+    std::string m_coalescePrefix;
+    std::string m_coalesceRow;
+    unsigned int m_coalesceParameterCount = 0;
+    //Selects the inserted columns of the table, used to find out if the statement sets the AUTO_INCREMENT column
+    std::string m_coalesceColumnProbe;
 };
 
 #endif
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "Query.h"
 #include "MySQLOOException.h"
+#include "Database.h"
+#include "ConnectionPoller.h"
 #include <iostream>
 #include <algorithm>
 #include <utility>
@@ -13,34 +15,115 @@ Query::Query(const std::shared_ptr<Database>& dbase, std::string query) : IQuery
 Query::~Query() = default;
 
 //Executes the raw query
-void Query::executeStatement(Database &database, MYSQL* connection, const std::shared_ptr<IQueryData>& data) {
-    auto queryData = std::dynamic_pointer_cast<QueryData>(data);
+void Query::executeStatement(DatabaseConnection &databaseConnection, MYSQL* connection, const std::shared_ptr<IQueryData>& data) {
+    auto *queryData = dynamic_cast<QueryData *>(data.get());
     Query::mysqlQuery(connection, this->m_query);
     //Stores all result sets
     //MySQL result sets shouldn't be accessed from different threads!
     do {
+        if (queryData->shouldStreamResults()) {
+            MYSQL_RES *results = Query::mysqlUseResults(connection);
+            auto resultFree = finally([&] { mysql_free_result(results); });
+            if (results != nullptr) {
+                streamResults(databaseConnection, connection, results, data);
+            }
+            //The rows have already been passed on, the callbacks receive an empty result set
+            queryData->m_results.push_back(ResultData::empty());
+            queryData->m_insertIds.push_back(mysql_insert_id(connection));
+            queryData->m_affectedRows.push_back(mysql_affected_rows(connection));
+            continue;
+        }
         MYSQL_RES * results = Query::mysqlStoreResults(connection);
-        auto resultFree = finally([&] { mysql_free_result(results); });
         if (results != nullptr) {
-            queryData->m_results.emplace_back(results);
+            //The result data takes ownership of the result set, it is freed together with the query data
+            queryData->m_results.push_back(std::make_shared<ResultData>(results));
         } else {
-            queryData->m_results.emplace_back();
+            queryData->m_results.push_back(ResultData::empty());
         }
         queryData->m_insertIds.push_back(mysql_insert_id(connection));
         queryData->m_affectedRows.push_back(mysql_affected_rows(connection));
     } while (Query::mysqlNextResult(connection));
 }
 
+bool Query::canRunNonBlocking(const IQueryData &data) const {
+    auto &queryData = dynamic_cast<const QueryData &>(data);
+    return !queryData.shouldStreamResults() && m_query.size() <= MAX_NON_BLOCKING_QUERY_LENGTH;
+}
+
+/* Same as executeStatement, but returns false instead of blocking while waiting for the server to respond.
+ * The query is sent, then the connection waits for its socket to become readable without occupying a thread.
+ * Once the server has responded, the results are read with the regular api. Only the first response is waited for,
+ * the results of multi statements might already be buffered by the client library, so they are read right away.
+ * The state is kept in the query data, so the next call continues where the previous one left off.
+ */
+bool Query::executeStatementNonBlocking(DatabaseConnection &databaseConnection, MYSQL *connection,
+                                        const std::shared_ptr<IQueryData> &data) {
+    auto *queryData = dynamic_cast<QueryData *>(data.get());
+    if (queryData->m_nonBlockingState == QueryData::NON_BLOCKING_SEND_QUERY) {
+        if (mysql_send_query(connection, m_query.c_str(), (unsigned long) m_query.length()) != 0) {
+            throw MySQLException(mysql_errno(connection), mysql_error(connection));
+        }
+        queryData->m_nonBlockingState = QueryData::NON_BLOCKING_READ_RESULT;
+        if (!ConnectionPoller::isReadable(connection)) {
+            return false;
+        }
+    }
+    queryData->m_nonBlockingState = QueryData::NON_BLOCKING_SEND_QUERY;
+    if (mysql_read_query_result(connection)) {
+        throw MySQLException(mysql_errno(connection), mysql_error(connection));
+    }
+    do {
+        MYSQL_RES *results = Query::mysqlStoreResults(connection);
+        if (results != nullptr) {
+            queryData->m_results.push_back(std::make_shared<ResultData>(results));
+        } else {
+            queryData->m_results.push_back(ResultData::empty());
+        }
+        queryData->m_insertIds.push_back(mysql_insert_id(connection));
+        queryData->m_affectedRows.push_back(mysql_affected_rows(connection));
+    } while (Query::mysqlNextResult(connection));
+    return true;
+}
+
+//Fetches the rows of a result set retrieved with mysql_use_result in chunks
+//Each chunk is passed to the main thread as soon as it has been fetched, so it can be passed to onData
+//Fetching pauses while the main thread is behind, see Database::putStreamedResult
+void Query::streamResults(DatabaseConnection &databaseConnection, MYSQL *connection, MYSQL_RES *results,
+                          const std::shared_ptr<IQueryData> &data) {
+    while (true) {
+        ResultData chunk(results, STREAM_CHUNK_SIZE);
+        const size_t rowCount = chunk.getRowCount();
+        if (rowCount > 0) {
+            databaseConnection.getDatabase().putStreamedResult(std::make_pair(shared_from_this(), data),
+                                                               std::move(chunk));
+        }
+        if (rowCount < STREAM_CHUNK_SIZE) {
+            //mysql_fetch_row returns null both at the end of the result set and on errors
+            unsigned int errorCode = mysql_errno(connection);
+            if (errorCode != 0) {
+                throw MySQLException(errorCode, mysql_error(connection));
+            }
+            return;
+        }
+    }
+}
+
+//Takes the chunks a streaming query has fetched so far, the connection continues fetching if it was paused
+void Query::takeStreamedResults(QueryData &data, std::deque<ResultData> &results) {
+    data.takeStreamedResults(results);
+    m_database->notifyStreamedResultsTaken();
+}
+
 void Query::clearResultData(const std::shared_ptr<IQueryData>& data) {
-    auto queryData = std::dynamic_pointer_cast<QueryData>(data);
+    auto *queryData = dynamic_cast<QueryData *>(data.get());
     queryData->m_results.clear();
     queryData->m_insertIds.clear();
     queryData->m_affectedRows.clear();
 }
 
 void Query::emplaceEmptyResultData(const std::shared_ptr<IQueryData>& data) {
-    auto queryData = std::dynamic_pointer_cast<QueryData>(data);
-    queryData->m_results.emplace_back();
+    auto *queryData = dynamic_cast<QueryData *>(data.get());
+    queryData->m_results.push_back(ResultData::empty());
     queryData->m_insertIds.push_back(0);
     queryData->m_affectedRows.push_back(0);
 }
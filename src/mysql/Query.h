@@ -2,6 +2,7 @@
 #define QUERY_
 
 #include <deque>
+#include <mutex>
 #include "IQuery.h"
 #include "ResultData.h"
 
@@ -15,7 +16,12 @@ class Query : public IQuery {
 public:
     ~Query() override;
 
-    void executeStatement(Database &database, MYSQL *m_sql, const std::shared_ptr<IQueryData> &data) override;
+    void executeStatement(DatabaseConnection &databaseConnection, MYSQL *m_sql, const std::shared_ptr<IQueryData> &data) override;
+
+    bool canRunNonBlocking(const IQueryData &data) const override;
+
+    bool executeStatementNonBlocking(DatabaseConnection &databaseConnection, MYSQL *m_sql,
+                                     const std::shared_ptr<IQueryData> &data) override;
 
     my_ulonglong lastInsert();
 
@@ -25,6 +31,8 @@ public:
 
     void getNextResults();
 
+    void takeStreamedResults(QueryData &data, std::deque<ResultData> &results);
+
     virtual std::shared_ptr<QueryData> buildQueryData();
 
     int m_dataReference = 0;
@@ -33,6 +41,12 @@ public:
 
     static std::shared_ptr<Query> create(const std::shared_ptr<Database> &dbase, const std::string &query);
 
+    //Maximum amount of rows that are passed to the main thread at once if OPTION_STREAM_RESULTS is set
+    static constexpr size_t STREAM_CHUNK_SIZE = 1000;
+
+    //Longer queries are sent with the blocking api, since only reading the response is waited for without blocking
+    static constexpr size_t MAX_NON_BLOCKING_QUERY_LENGTH = 16 * 1024;
+
 protected:
     Query(const std::shared_ptr<Database> &dbase, std::string query);
 
@@ -41,6 +55,9 @@ protected:
     static void emplaceEmptyResultData(const std::shared_ptr<IQueryData> &data);
 
     static void clearResultData(const std::shared_ptr<IQueryData> &data);
+
+    void streamResults(DatabaseConnection &databaseConnection, MYSQL *connection, MYSQL_RES *results,
+                       const std::shared_ptr<IQueryData> &data);
 };
 
 class QueryData : public IQueryData {
@@ -68,17 +85,63 @@ public:
     }
 
     ResultData &getResult() {
+        return *m_results.front();
+    }
+
+    //Lazy results of lua share the result set, so it stays alive even after the query data is gone
+    const std::shared_ptr<ResultData> &getSharedResult() {
         return m_results.front();
     }
 
-    std::deque<ResultData> getResults() {
+    std::deque<std::shared_ptr<ResultData>> &getResults() {
         return m_results;
     }
 
+    //Only queries started on their own stream their results, queries of a transaction never do
+    bool shouldStreamResults() const {
+        return m_streamResults;
+    }
+
+    void setStreamResults(bool streamResults) {
+        m_streamResults = streamResults;
+    }
+
+    //Rows of a streaming query that were fetched by the database thread but not passed to lua yet
+    void addStreamedResult(ResultData &&result) {
+        std::lock_guard<std::mutex> lock(m_streamedResultMutex);
+        m_streamedResults.push_back(std::move(result));
+        m_hasStreamedResults = true;
+    }
+
+    void takeStreamedResults(std::deque<ResultData> &results) {
+        std::lock_guard<std::mutex> lock(m_streamedResultMutex);
+        results.swap(m_streamedResults);
+    }
+
+    size_t getStreamedResultCount() {
+        std::lock_guard<std::mutex> lock(m_streamedResultMutex);
+        return m_streamedResults.size();
+    }
+
+    //Rows that were already passed on can't be fetched a second time
+    bool canRetry() const override {
+        return !m_hasStreamedResults;
+    }
+
 protected:
     std::deque<my_ulonglong> m_affectedRows;
     std::deque<my_ulonglong> m_insertIds;
-    std::deque<ResultData> m_results;
+    std::deque<std::shared_ptr<ResultData>> m_results;
+    bool m_streamResults = false;
+    std::mutex m_streamedResultMutex;
+    std::deque<ResultData> m_streamedResults;
+    std::atomic<bool> m_hasStreamedResults{false};
+    //Progress of a non blocking query, see Query::executeStatementNonBlocking
+    enum NonBlockingState {
+        NON_BLOCKING_SEND_QUERY,
+        NON_BLOCKING_READ_RESULT
+    };
+    NonBlockingState m_nonBlockingState = NON_BLOCKING_SEND_QUERY;
 
     QueryData() = default;
 };
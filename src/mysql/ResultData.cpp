@@ -2,37 +2,78 @@
 #include "IQuery.h"
 #include "Database.h"
 #include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
 
-ResultData::ResultData(const unsigned int columnCount, const unsigned int rows) {
+ResultData::ResultData(const unsigned int columnCount, const size_t rows) {
 	this->columnCount = columnCount;
 	this->columns.resize(columnCount);
 	this->columnTypes.resize(columnCount);
-	this->rows.reserve(rows);
+	this->columnData.resize(columnCount);
+	for (auto& column : this->columnData) {
+		column.offsets.reserve(rows);
+		column.lengths.reserve(rows);
+		column.nullBitmap.reserve((rows + 7) / 8);
+	}
 }
 
-ResultData::ResultData() : ResultData(static_cast<unsigned int>(0), static_cast<unsigned int>(0)) {} //Avoids conflict with pointers
+ResultData::ResultData() : ResultData(static_cast<unsigned int>(0), static_cast<size_t>(0)) {} //Avoids conflict with pointers
 
 //Stores all of the rows of a result set
-//This is used so the result set can be free'd and doesn't have to be used in
-//another thread (which is not safe)
-ResultData::ResultData(MYSQL_RES* result) : ResultData(mysql_num_fields(result), static_cast<unsigned int>(mysql_num_rows(result))) {
+//The stored result is not tied to the connection anymore, so its rows can safely be read
+//from the main thread while the connection already runs other queries.
+//Only the row pointers and lengths are collected here, the cells themselves are never copied.
+ResultData::ResultData(MYSQL_RES* result) : ResultData(mysql_num_fields(result), static_cast<size_t>(0)) {
+	this->result.reset(result);
 	if (columnCount == 0) return;
+	const auto rows = static_cast<size_t>(mysql_num_rows(result));
 	for (unsigned int i = 0; i < columnCount; i++) {
 		const MYSQL_FIELD *field = mysql_fetch_field_direct(result, i);
-		columnTypes[i] = field->type;
+		setColumnType(i, field->type, rows);
 		columns[i] = field->name;
 	}
+	resultRows.reserve(rows);
+	resultLengths.reserve(rows * columnCount);
 	MYSQL_ROW currentRow;
 	//This shouldn't error since mysql_store_results stores ALL rows already
 	while ((currentRow = mysql_fetch_row(result)) != nullptr) {
-		unsigned long *lengths = mysql_fetch_lengths(result);
-		this->rows.emplace_back(lengths, currentRow, columnCount);
+		//The lengths array is overwritten by each fetch, so it needs to be copied
+		const unsigned long *lengths = mysql_fetch_lengths(result);
+		resultRows.push_back(currentRow);
+		resultLengths.insert(resultLengths.end(), lengths, lengths + columnCount);
+		for (unsigned int i = 0; i < columnCount; i++) {
+			addNumber(i, currentRow[i], lengths[i], currentRow[i] == nullptr);
+		}
+		rowCount++;
 	}
 }
 
+//Copies up to maxRows rows of a result set that was retrieved with mysql_use_result
+//The rows of such a result set are overwritten by the next fetch, so they need to be copied into the arena
+//The caller has to check for errors if less than maxRows rows were copied
+ResultData::ResultData(MYSQL_RES* result, size_t maxRows) : ResultData(mysql_num_fields(result), maxRows) {
+	if (columnCount == 0) return;
+	for (unsigned int i = 0; i < columnCount; i++) {
+		const MYSQL_FIELD *field = mysql_fetch_field_direct(result, i);
+		setColumnType(i, field->type, maxRows);
+		columns[i] = field->name;
+	}
+	MYSQL_ROW currentRow;
+	while (rowCount < maxRows && (currentRow = mysql_fetch_row(result)) != nullptr) {
+		const unsigned long *lengths = mysql_fetch_lengths(result);
+		for (unsigned int i = 0; i < columnCount; i++) {
+			addField(i, currentRow[i], lengths[i], currentRow[i] == nullptr);
+		}
+		rowCount++;
+	}
+}
+
+//Truncated rows are returned as well, the truncated columns are fetched again by the caller
 static bool mysqlStmtFetch(MYSQL_STMT* stmt) {
 	int result = mysql_stmt_fetch(stmt);
-	if (result == 0) return true;
+	if (result == 0 || result == MYSQL_DATA_TRUNCATED) return true;
 	if (result == 1) {
 		const char* errorMessage = mysql_stmt_error(stmt);
 		unsigned int errorCode = mysql_stmt_errno(stmt);
@@ -49,69 +90,258 @@ static void mysqlStmtBindResult(MYSQL_STMT* stmt, MYSQL_BIND* bind) {
 	}
 }
 
-//Stores all of the rows of a prepared query
+//Fetches a column whose value did not fit into its buffer again, after growing the buffer to the value's size
+static void mysqlStmtFetchTruncatedColumn(MYSQL_STMT* stmt, MYSQL_BIND& bind, std::vector<char>& buffer, unsigned int column) {
+	buffer.resize(*bind.length + 1);
+	bind.buffer = buffer.data();
+	bind.buffer_length = *bind.length + 1;
+	if (mysql_stmt_fetch_column(stmt, &bind, column, 0)) {
+		const char* errorMessage = mysql_stmt_error(stmt);
+		unsigned int errorCode = mysql_stmt_errno(stmt);
+		throw MySQLException(errorCode, errorMessage);
+	}
+}
+
+//Formats a MYSQL_TIME the same way the text protocol would
+static size_t formatTime(const MYSQL_TIME &time, int type, unsigned int decimals, char *buffer, size_t bufferLength) {
+	int length;
+	switch (type) {
+		case MYSQL_TYPE_DATE:
+			length = snprintf(buffer, bufferLength, "%04u-%02u-%02u", time.year, time.month, time.day);
+			break;
+		case MYSQL_TYPE_TIME:
+			length = snprintf(buffer, bufferLength, "%s%02u:%02u:%02u", time.neg ? "-" : "",
+			                  time.day * 24 + time.hour, time.minute, time.second);
+			break;
+		default:
+			length = snprintf(buffer, bufferLength, "%04u-%02u-%02u %02u:%02u:%02u", time.year, time.month, time.day,
+			                  time.hour, time.minute, time.second);
+			break;
+	}
+	if (type != MYSQL_TYPE_DATE && decimals > 0 && decimals <= 6) {
+		unsigned long fraction = time.second_part;
+		for (unsigned int i = decimals; i < 6; i++) {
+			fraction /= 10;
+		}
+		length += snprintf(buffer + length, bufferLength - length, ".%0*lu", (int) decimals, fraction);
+	}
+	return (size_t) length;
+}
+
+//Stores up to maxRows rows of a prepared query
 //This needs to be done because the query shouldn't be accessed from a different thread
-ResultData::ResultData(MYSQL_STMT* result, MYSQL_RES* metaData) : ResultData((unsigned int)mysql_stmt_field_count(result), (unsigned int)mysql_stmt_num_rows(result)) {
+//If the result was not stored, the rows are fetched from the server and the caller has to check if more rows are left
+//Integer, double and temporal columns are fetched in their binary form, so the server does not have to
+//convert them to strings only for them to be parsed again
+//The binds and buffers of the statement are reused, they are only grown if they are too small for this result
+ResultData::ResultData(MYSQL_STMT* result, MYSQL_RES* metaData, StatementBuffers& statementBuffers, size_t maxRows) : ResultData((unsigned int)mysql_stmt_field_count(result), std::min((size_t)mysql_stmt_num_rows(result), maxRows)) {
 	if (this->columnCount == 0) return;
 	MYSQL_FIELD* fields = mysql_fetch_fields(metaData);
-	std::vector<MYSQL_BIND> binds(columnCount);
-	std::vector<std::vector<char>> buffers;
-	std::vector<unsigned long> lengths(columnCount);
-	//This is needed because C++ is stupid and std::vector<bool> is using bit encoding....
-	auto* isFieldNullArr = new bool[columnCount];
-	auto fieldNullArrFree = finally([&] {
-		delete[] isFieldNullArr;
-	});
+	statementBuffers.resizeResult(columnCount);
+	auto& binds = statementBuffers.resultBinds;
+	auto& buffers = statementBuffers.resultBuffers;
+	auto& integers = statementBuffers.integers;
+	auto& doubles = statementBuffers.doubles;
+	auto& times = statementBuffers.times;
+	auto& lengths = statementBuffers.lengths;
+	bool* isFieldNullArr = statementBuffers.isNull.get();
 	for (unsigned int i = 0; i < columnCount; i++) {
-		columnTypes[i] = fields[i].type;
+		setColumnType(i, fields[i].type, std::min((size_t) mysql_stmt_num_rows(result), maxRows));
 		columns[i] = fields[i].name;
 		MYSQL_BIND& bind = binds[i];
-		bind.buffer_type = MYSQL_TYPE_STRING;
-		buffers.emplace_back(fields[i].max_length + 2);
-		bind.buffer = buffers.back().data();
-		bind.buffer_length = fields[i].max_length + 1;
+		std::memset(&bind, 0, sizeof(MYSQL_BIND));
 		bind.length = &lengths[i];
 		bind.is_null = &isFieldNullArr[i];
-		bind.is_unsigned = false;
+		bind.is_unsigned = (fields[i].flags & UNSIGNED_FLAG) != 0;
+		switch (fields[i].type) {
+			case MYSQL_TYPE_TINY:
+			case MYSQL_TYPE_SHORT:
+			case MYSQL_TYPE_INT24:
+			case MYSQL_TYPE_LONG:
+			case MYSQL_TYPE_LONGLONG:
+				bind.buffer_type = MYSQL_TYPE_LONGLONG;
+				bind.buffer = &integers[i];
+				break;
+			case MYSQL_TYPE_DOUBLE:
+				bind.buffer_type = MYSQL_TYPE_DOUBLE;
+				bind.buffer = &doubles[i];
+				break;
+			case MYSQL_TYPE_DATE:
+			case MYSQL_TYPE_TIME:
+			case MYSQL_TYPE_DATETIME:
+			case MYSQL_TYPE_TIMESTAMP:
+				bind.buffer_type = fields[i].type;
+				bind.buffer = &times[i];
+				break;
+			default: {
+				//FLOAT is fetched as a string as well, since the server rounds it to its displayed precision
+				//max_length is only known for stored results, otherwise the buffer grows once a value is truncated
+				bind.buffer_type = MYSQL_TYPE_STRING;
+				const size_t bufferSize = std::max(fields[i].max_length + 2, (unsigned long) 64);
+				if (buffers[i].size() < bufferSize) {
+					buffers[i].resize(bufferSize);
+				}
+				bind.buffer = buffers[i].data();
+				bind.buffer_length = (unsigned long) buffers[i].size() - 1;
+				bind.is_unsigned = false;
+				break;
+			}
+		}
 	}
 	mysqlStmtBindResult(result, binds.data());
-	while (mysqlStmtFetch(result)) {
-		this->rows.emplace_back(result, binds.data(), columnCount);
+	char timeBuffer[64];
+	while (rowCount < maxRows && mysqlStmtFetch(result)) {
+		bool rebind = false;
+		for (unsigned int i = 0; i < columnCount; i++) {
+			const bool isNull = isFieldNullArr[i];
+			switch (binds[i].buffer_type) {
+				case MYSQL_TYPE_LONGLONG:
+					addNumericField(i, binds[i].is_unsigned ? (double) (unsigned long long) integers[i]
+					                                        : (double) integers[i], isNull);
+					break;
+				case MYSQL_TYPE_DOUBLE:
+					addNumericField(i, doubles[i], isNull);
+					break;
+				case MYSQL_TYPE_DATE:
+				case MYSQL_TYPE_TIME:
+				case MYSQL_TYPE_DATETIME:
+				case MYSQL_TYPE_TIMESTAMP:
+					if (isNull) {
+						addField(i, nullptr, 0, true);
+					} else {
+						size_t length = formatTime(times[i], binds[i].buffer_type, fields[i].decimals,
+						                           timeBuffer, sizeof(timeBuffer));
+						addField(i, timeBuffer, length, false);
+					}
+					break;
+				default:
+					if (!isNull && lengths[i] > binds[i].buffer_length) {
+						mysqlStmtFetchTruncatedColumn(result, binds[i], buffers[i], i);
+						rebind = true;
+					}
+					addField(i, isNull ? nullptr : buffers[i].data(), isNull ? 0 : lengths[i], isNull);
+					break;
+			}
+		}
+		if (rebind) {
+			mysqlStmtBindResult(result, binds.data());
+		}
+		rowCount++;
 	}
 }
 
 ResultData::~ResultData() = default;
 
-ResultDataRow::ResultDataRow(unsigned int columnCount) {
-	this->columnCount = columnCount;
-	this->values.resize(columnCount);
-	this->nullFields.resize(columnCount);
+const std::shared_ptr<ResultData>& ResultData::empty() {
+	static const std::shared_ptr<ResultData> emptyResult = std::make_shared<ResultData>();
+	return emptyResult;
 }
 
-//Datastructure that stores a row of mysql data
-ResultDataRow::ResultDataRow(unsigned long *lengths, MYSQL_ROW row, unsigned int columnCount) : ResultDataRow(columnCount) {
+//Describes the storage of this result set without copying any of it, rawColumns has to outlive the returned result
+RawResult ResultData::getRawResult(std::vector<RawResultColumn> &rawColumns) const {
+	rawColumns.resize(columnCount);
 	for (unsigned int i = 0; i < columnCount; i++) {
-		if (row[i]) {
-			this->values[i] = std::string(row[i], lengths[i]);
-		} else {
-			if (lengths[i] == 0) {
-				this->nullFields[i] = true;
-			}
-			this->values[i] = "";
-		}
+		const ResultDataColumn &resultColumn = columnData[i];
+		RawResultColumn &rawColumn = rawColumns[i];
+		rawColumn.name = columns[i].c_str();
+		rawColumn.nameLength = columns[i].length();
+		rawColumn.type = columnTypes[i];
+		rawColumn.isNumeric = resultColumn.isNumeric;
+		rawColumn.offsets = resultColumn.offsets.data();
+		rawColumn.lengths = resultColumn.lengths.data();
+		rawColumn.nullBitmap = resultColumn.nullBitmap.data();
+		rawColumn.numbers = resultColumn.numbers.data();
 	}
+	RawResult raw{};
+	raw.rowCount = rowCount;
+	raw.columnCount = columnCount;
+	raw.isStoredResult = result != nullptr;
+	raw.columns = rawColumns.data();
+	raw.arena = arena.data();
+	raw.rows = resultRows.data();
+	raw.rowLengths = resultLengths.data();
+	return raw;
 }
 
-//Datastructure that stores a row of mysql data of a prepared query
-ResultDataRow::ResultDataRow(MYSQL_STMT* statement, MYSQL_BIND* bind, unsigned int columnCount) : ResultDataRow(columnCount) {
-	for (unsigned int i = 0; i < columnCount; i++) {
-		if (!*(bind[i].is_null) && bind[i].buffer) {
-			this->values[i] = std::string((char*)bind[i].buffer, *bind[i].length);
-		} else {
-			if (*(bind[i].is_null)) {
-				this->nullFields[i] = true;
-			}
-			this->values[i] = "";
+static bool isNumericType(int type) {
+	switch (type) {
+		case MYSQL_TYPE_FLOAT:
+		case MYSQL_TYPE_DOUBLE:
+		case MYSQL_TYPE_LONGLONG:
+		case MYSQL_TYPE_LONG:
+		case MYSQL_TYPE_INT24:
+		case MYSQL_TYPE_TINY:
+		case MYSQL_TYPE_SHORT:
+		case MYSQL_TYPE_BIT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void ResultData::setColumnType(unsigned int column, int type, size_t rows) {
+	columnTypes[column] = type;
+	ResultDataColumn &resultColumn = columnData[column];
+	resultColumn.isNumeric = isNumericType(type);
+	if (resultColumn.isNumeric) {
+		resultColumn.numbers.reserve(rows);
+	}
+}
+
+//Converts the value of a numeric cell to a number, so the main thread only has to push it to lua
+//Null values are stored as 0 but are never read
+void ResultData::addNumber(unsigned int column, const char *value, size_t length, bool isNull) {
+	ResultDataColumn &resultColumn = columnData[column];
+	if (!resultColumn.isNumeric) return;
+	if (isNull || value == nullptr) {
+		resultColumn.numbers.push_back(0);
+	} else if (columnTypes[column] == MYSQL_TYPE_BIT) {
+		// BIT fields are returned as binary data
+		// Convert bytes to unsigned integer (big-endian)
+		unsigned long long bitValue = 0;
+		for (size_t i = 0; i < length && i < 8; i++) {
+			bitValue = bitValue << 8 | static_cast<unsigned char>(value[i]);
 		}
+		resultColumn.numbers.push_back(static_cast<double>(bitValue));
+	} else {
+		//Values are always null terminated
+		resultColumn.numbers.push_back(atof(value));
+	}
+}
+
+//Sets the null bit of the current row of a column
+void ResultData::setFieldNull(unsigned int column, bool isNull) {
+	ResultDataColumn &resultColumn = columnData[column];
+	if (rowCount % 8 == 0) {
+		resultColumn.nullBitmap.push_back(0);
+	}
+	if (isNull) {
+		resultColumn.nullBitmap.back() |= static_cast<uint8_t>(1u << (rowCount % 8));
+	}
+}
+
+//Appends the value of a cell of the current row to the arena of this result set
+void ResultData::addField(unsigned int column, const char *value, size_t length, bool isNull) {
+	ResultDataColumn &resultColumn = columnData[column];
+	setFieldNull(column, isNull);
+	if (isNull) {
+		length = 0;
+	}
+	addNumber(column, value, length, isNull);
+	resultColumn.offsets.push_back(arena.size());
+	resultColumn.lengths.push_back(length);
+	if (length > 0) {
+		arena.insert(arena.end(), value, value + length);
 	}
-}
\ No newline at end of file
+	//Keeps every value null terminated so it can be passed to C string functions directly
+	arena.push_back('\0');
+}
+
+//Appends a cell that was fetched as a binary number, it does not take up any space in the arena
+void ResultData::addNumericField(unsigned int column, double value, bool isNull) {
+	ResultDataColumn &resultColumn = columnData[column];
+	setFieldNull(column, isNull);
+	resultColumn.offsets.push_back(arena.size());
+	resultColumn.lengths.push_back(0);
+	resultColumn.numbers.push_back(isNull ? 0 : value);
+}
@@ -2,41 +2,130 @@
 #define RESULTDATA_
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <cstdint>
 #include "MySQLHeader.h"
+#include "StatementHandle.h"
 
+class ResultData;
+
+/* Plain description of where the cells of a result set are stored, read by the LuaJIT ffi (see lua/mysqlooffi.lua).
+ * The layout of these structs must match the ffi.cdef of that file.
+ */
+struct RawResultColumn {
+	const char *name;
+	size_t nameLength;
+	int type;
+	int isNumeric;
+	//Only used if the cells are stored in the arena
+	const size_t *offsets;
+	const size_t *lengths;
+	const uint8_t *nullBitmap;
+	//Only used for numeric columns
+	const double *numbers;
+};
+
+struct RawResult {
+	size_t rowCount;
+	unsigned int columnCount;
+	int isStoredResult; //If set, the cells are read from rows instead of the arena
+	const RawResultColumn *columns;
+	const char *arena;
+	const MYSQL_ROW *rows;
+	const unsigned long *rowLengths; //rowCount * columnCount lengths, ordered by row
+};
+
+//Lightweight view of a single row of a ResultData, does not own any data
 class ResultDataRow {
 public:
-	ResultDataRow(unsigned long *lengths, MYSQL_ROW row, unsigned int columnCount);
-	ResultDataRow(MYSQL_STMT* statement, MYSQL_BIND* bind, unsigned int columnCount);
-	std::vector<std::string> & getValues() {
-		return values;
-	}
-	bool isFieldNull(const unsigned int index) {
-		return nullFields[index];
-	}
+	ResultDataRow(const ResultData &data, size_t row) : data(data), row(row) {}
+	std::string_view getValue(unsigned int column) const;
+	bool isFieldNull(unsigned int column) const;
 private:
-	explicit ResultDataRow(unsigned int columns);
-	unsigned long long columnCount = 0;
-	std::vector<bool> nullFields;
-	std::vector<std::string> values;
+	const ResultData &data;
+	size_t row;
 };
 
+/* Stores a result set in a columnar layout.
+ * All cell values are stored back to back (and null terminated) in one byte arena,
+ * each column only stores the offsets/lengths of its cells into that arena and a packed null bitmap.
+ * Results of plain queries are not copied at all, instead the stored MYSQL_RES is kept alive
+ * and the cells are read directly from its rows.
+ */
 class ResultData {
 public:
+	//Takes ownership of the stored result, it is freed once this result data is destroyed
 	explicit ResultData(MYSQL_RES* result);
-	ResultData(MYSQL_STMT* result, MYSQL_RES* metaData);
+	//Copies the rows of a result set that was retrieved with mysql_use_result
+	ResultData(MYSQL_RES* result, size_t maxRows);
+	ResultData(MYSQL_STMT* result, MYSQL_RES* metaData, StatementBuffers& statementBuffers, size_t maxRows = SIZE_MAX);
 	ResultData();
 	~ResultData();
-	std::vector<std::string> & getColumns() { return columns; }
-	std::vector<ResultDataRow> & getRows() { return rows; }
-	std::vector<int> & getColumnTypes() { return columnTypes; }
+	//Shared by all result sets without any rows or columns, it is never modified
+	static const std::shared_ptr<ResultData>& empty();
+	ResultData(ResultData&&) = default;
+	ResultData& operator=(ResultData&&) = default;
+	const std::vector<std::string> & getColumns() const { return columns; }
+	const std::vector<int> & getColumnTypes() const { return columnTypes; }
+	unsigned int getColumnCount() const { return columnCount; }
+	size_t getRowCount() const { return rowCount; }
+	ResultDataRow getRow(size_t row) const { return {*this, row}; }
+	std::string_view getValue(size_t row, unsigned int column) const {
+		if (result != nullptr) {
+			const char *value = resultRows[row][column];
+			return {value != nullptr ? value : "", resultLengths[row * columnCount + column]};
+		}
+		const ResultDataColumn &resultColumn = columnData[column];
+		return {arena.data() + resultColumn.offsets[row], resultColumn.lengths[row]};
+	}
+	bool isFieldNull(size_t row, unsigned int column) const {
+		if (result != nullptr) {
+			return resultRows[row][column] == nullptr;
+		}
+		return (columnData[column].nullBitmap[row / 8] >> (row % 8)) & 1;
+	}
+	//Numeric and BIT columns are already converted to numbers by the database thread
+	//Integer and double columns of prepared queries are fetched as binary numbers and have no string value
+	bool isNumericColumn(unsigned int column) const { return columnData[column].isNumeric; }
+	double getNumber(size_t row, unsigned int column) const { return columnData[column].numbers[row]; }
+	//The pointers stay valid as long as this result data exists
+	RawResult getRawResult(std::vector<RawResultColumn> &rawColumns) const;
 private:
-	ResultData(unsigned int columns, unsigned int rows);
+	struct ResultDataColumn {
+		std::vector<size_t> offsets;
+		std::vector<size_t> lengths;
+		std::vector<uint8_t> nullBitmap;
+		bool isNumeric = false;
+		std::vector<double> numbers;
+	};
+	struct ResultFree {
+		void operator()(MYSQL_RES* res) const { mysql_free_result(res); }
+	};
+	ResultData(unsigned int columns, size_t rows);
+	void setColumnType(unsigned int column, int type, size_t rows);
+	void setFieldNull(unsigned int column, bool isNull);
+	void addField(unsigned int column, const char *value, size_t length, bool isNull);
+	void addNumericField(unsigned int column, double value, bool isNull);
+	void addNumber(unsigned int column, const char *value, size_t length, bool isNull);
 	unsigned int columnCount = 0;
+	size_t rowCount = 0;
 	std::vector<std::string> columns;
 	std::vector<int> columnTypes;
-	std::vector<ResultDataRow> rows;
+	std::vector<ResultDataColumn> columnData;
+	std::vector<char> arena;
+	//Only used if the rows are read directly from a stored result
+	std::unique_ptr<MYSQL_RES, ResultFree> result;
+	std::vector<MYSQL_ROW> resultRows;
+	std::vector<unsigned long> resultLengths;
 };
 
-#endif
\ No newline at end of file
+inline std::string_view ResultDataRow::getValue(unsigned int column) const {
+	return data.getValue(row, column);
+}
+
+inline bool ResultDataRow::isFieldNull(unsigned int column) const {
+	return data.isFieldNull(row, column);
+}
+
+#endif
@@ -1,13 +1,45 @@
 #ifndef MYSQLOO_STATEMENTHANDLE_H
 #define MYSQLOO_STATEMENTHANDLE_H
 
+#include <vector>
+#include <memory>
 #include "mysql/mysql.h"
 
+/* Binds and buffers that are reused by all executions of a statement, so executing a cached statement
+ * does not allocate them again. The buffers only ever grow, e.g. if a longer string than before is fetched.
+ */
+struct StatementBuffers {
+    std::vector<MYSQL_BIND> parameterBinds;
+    std::vector<MYSQL_BIND> resultBinds;
+    std::vector<std::vector<char>> resultBuffers;
+    std::vector<long long> integers;
+    std::vector<double> doubles;
+    std::vector<MYSQL_TIME> times;
+    std::vector<unsigned long> lengths;
+    //Not a std::vector<bool>, since that doesn't store actual bools
+    std::unique_ptr<bool[]> isNull;
+    size_t isNullSize = 0;
+
+    void resizeResult(unsigned int columnCount) {
+        resultBinds.resize(columnCount);
+        resultBuffers.resize(columnCount);
+        integers.resize(columnCount);
+        doubles.resize(columnCount);
+        times.resize(columnCount);
+        lengths.resize(columnCount);
+        if (isNullSize < columnCount) {
+            isNull = std::make_unique<bool[]>(columnCount);
+            isNullSize = columnCount;
+        }
+    }
+};
+
 class StatementHandle {
 public:
     StatementHandle(MYSQL_STMT *stmt, bool valid);
 
     MYSQL_STMT *stmt = nullptr;
+    StatementBuffers buffers{};
 
     bool isValid() const { return stmt != nullptr && valid; };
 
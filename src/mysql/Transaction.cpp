@@ -4,8 +4,8 @@
 #include "Database.h"
 
 
-void Transaction::executeStatement(Database &database, MYSQL *connection, const std::shared_ptr<IQueryData>& ptr) {
-    std::shared_ptr<TransactionData> data = std::dynamic_pointer_cast<TransactionData>(ptr);
+void Transaction::executeStatement(DatabaseConnection &databaseConnection, MYSQL *connection, const std::shared_ptr<IQueryData>& ptr) {
+    auto *data = dynamic_cast<TransactionData *>(ptr.get());
     data->setStatus(QUERY_RUNNING);
     try {
         for (auto &query: data->m_queries) {
@@ -20,7 +20,7 @@ void Transaction::executeStatement(Database &database, MYSQL *connection, const
 
         for (auto &query: data->m_queries) {
             try {
-                query.first->executeStatement(database, connection, query.second);
+                query.first->executeStatement(databaseConnection, connection, query.second);
                 query.second->setStatus(QUERY_COMPLETE);
                 query.second->setResultStatus(QUERY_SUCCESS);
             } catch (const MySQLException &error) {
@@ -82,10 +82,10 @@ void Transaction::mysqlCommit(MYSQL *sql) {
 
 
 std::shared_ptr<TransactionData>
-Transaction::buildQueryData(const std::deque<std::pair<std::shared_ptr<Query>, std::shared_ptr<IQueryData>>> &queries) {
+Transaction::buildQueryData(std::deque<std::pair<std::shared_ptr<Query>, std::shared_ptr<IQueryData>>> queries) {
     //At this point the transaction is guaranteed to have a referenced table
     //since this is always called shortly after transaction:start()
-    return std::shared_ptr<TransactionData>(new TransactionData(queries));
+    return std::shared_ptr<TransactionData>(new TransactionData(std::move(queries)));
 }
 
 std::shared_ptr<Transaction> Transaction::create(const std::shared_ptr<Database> &database) {
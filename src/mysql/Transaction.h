@@ -28,14 +28,14 @@ class Transaction : public IQuery {
 
 public:
     static std::shared_ptr<TransactionData>
-    buildQueryData(const std::deque<std::pair<std::shared_ptr<Query>, std::shared_ptr<IQueryData>>> &queries);
+    buildQueryData(std::deque<std::pair<std::shared_ptr<Query>, std::shared_ptr<IQueryData>>> queries);
 
     static std::shared_ptr<Transaction> create(const std::shared_ptr<Database> &database);
 
     std::string getSQLString() override { return ""; };
 
 protected:
-    void executeStatement(Database &database, MYSQL *connection, const std::shared_ptr<IQueryData> &data) override;
+    void executeStatement(DatabaseConnection &databaseConnection, MYSQL *connection, const std::shared_ptr<IQueryData> &data) override;
 
     explicit Transaction(const std::shared_ptr<Database> &database) : IQuery(database) {
 